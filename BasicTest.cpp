@@ -3,6 +3,17 @@
 #include <string>
 #include <functional>
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <iterator>
+#include <cstdio>
 #include <unistd.h>
 #include "matrix.hpp"
 
@@ -51,7 +62,7 @@ void ceTest()
 	Matrix<int> a;
 	Matrix<double> b;
 
-	auto a1 = a * 5;
+	Matrix<int> a1 = a * 5;
 	a1 = 5 * a;
 	a1 = 0.5 * a;
 
@@ -304,6 +315,1598 @@ std::pair<bool, std::string> testOperations()
 	return { true, "Congratulation!" };
 };
 
+std::pair<bool, std::string> testLargeMultiplication()
+{
+	// large enough to go through the blocked kernel, with ragged edges
+	const std::size_t n = 67, k = 301, m = 45;
+	try
+	{
+		Matrix<int> a(n, k), b(k, m);
+		for (std::size_t i = 0; i < n; ++i)
+			for (std::size_t j = 0; j < k; ++j)
+				a(i, j) = int((i * 7 + j * 3) % 11) - 5;
+		for (std::size_t i = 0; i < k; ++i)
+			for (std::size_t j = 0; j < m; ++j)
+				b(i, j) = int((i * 5 + j) % 13) - 6;
+		auto c = a * b;
+		for (std::size_t i = 0; i < n; ++i)
+			for (std::size_t j = 0; j < m; ++j)
+			{
+				int sum = 0;
+				for (std::size_t p = 0; p < k; ++p)
+					sum += a(i, p) * b(p, j);
+				if (c(i, j) != sum)
+					return WA("large *");
+			}
+		Matrix<double> d(b);
+		auto e = a * d;
+		if (typeid(e(0, 0)) != typeid(d(0, 0)) || Matrix<int>(e) != c)
+			return WA("large mixed *");
+	} catch (...)
+	{
+		return RE("large *");
+	}
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testSimdLevels()
+{
+	// every instruction set the host supports must agree with the scalar path
+	Matrix<int> a(37, 41), b(41, 29);
+	for (std::size_t i = 0; i < a.Size(); ++i)
+		a[i] = int(i % 17) - 8;
+	for (std::size_t i = 0; i < b.Size(); ++i)
+		b[i] = int(i % 13) - 6;
+	Matrix<double> da(a), db(b);
+	Matrix<float> fa(a);
+	auto chain = [](const auto &x)
+	{
+		typename std::decay<decltype(x)>::type r = x + x, s = r * 3;
+		s = -s;
+		r = s - x;
+		r += x;
+		return r;
+	};
+	sjtu::simd::setLevel(sjtu::simd::NONE);
+	const Matrix<int> c = a * b, d = chain(a);
+	const Matrix<double> dc = da * db;
+	const Matrix<float> fd = chain(fa);
+	for (int lv = sjtu::simd::SSE4; lv <= sjtu::simd::AVX512; ++lv)
+	{
+		sjtu::simd::setLevel(sjtu::simd::Level(lv));
+		try
+		{
+			if (a * b != c || da * db != dc)
+				return WA("simd *");
+			if (chain(a) != d || chain(fa) != fd)
+				return WA("simd + / - / *");
+		} catch (...)
+		{
+			sjtu::simd::setLevel(sjtu::simd::AVX512);
+			return RE("simd");
+		}
+	}
+	sjtu::simd::setLevel(sjtu::simd::AVX512);
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testThreadPool()
+{
+	Matrix<double> a(300, 200), b(200, 310);
+	for (std::size_t i = 0; i < a.Size(); ++i)
+		a[i] = double(i % 7) - 3;
+	for (std::size_t i = 0; i < b.Size(); ++i)
+		b[i] = double(i % 5) - 2;
+	sjtu::ThreadPool::setGlobalThreads(1);
+	const auto c = a * b;
+	const Matrix<double> t = a.tran();
+	try
+	{
+		sjtu::ThreadPool::setGlobalThreads(4);
+		if (a * b != c)
+			return WA("parallel *");
+		if (Matrix<double>(a.tran()) != t)
+			return WA("parallel tran");
+		std::atomic<int> count(0);
+		sjtu::ThreadPool::global().parallelFor(10, [&](std::size_t)
+		{
+			sjtu::ThreadPool::global().parallelFor(10, [&](std::size_t)
+			{
+				++count;
+			});
+		});
+		if (count != 100)
+			return WA("nested parallelFor");
+		// concurrent callers share the pool; later ones may run inline
+		std::vector<std::thread> callers;
+		std::atomic<int> wrong(0);
+		for (int k = 0; k < 4; ++k)
+			callers.emplace_back([&]
+			{
+				for (int round = 0; round < 50; ++round)
+				{
+					std::atomic<long> sum(0);
+					sjtu::ThreadPool::global().parallelFor(16, [&](std::size_t i)
+					{
+						std::this_thread::sleep_for(std::chrono::microseconds(i % 3 * 50));
+						sum += long(i);
+					});
+					if (sum != 120)
+						++wrong;
+				}
+			});
+		for (auto &caller : callers)
+			caller.join();
+		if (wrong != 0)
+			return WA("concurrent parallelFor");
+	} catch (...)
+	{
+		return RE("thread pool");
+	}
+	bool thrown = false;
+	try
+	{
+		sjtu::ThreadPool::global().parallelFor(64, [](std::size_t i)
+		{
+			if (i == 42)
+				throw std::invalid_argument("task");
+		});
+	} catch (const std::invalid_argument &msg)
+	{
+		thrown = true;
+	} catch (...)
+	{
+		return RE("parallelFor exception");
+	}
+	if (!thrown)
+		return WA("parallelFor exception");
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testExpressions()
+{
+	Matrix<int> a = {{ 1, 2, 3 },
+					 { 4, 5, 6 }};
+	Matrix<double> b = {{ 0.5, 1.5, 2.5 },
+						{ 3.5, 4.5, 5.5 }};
+	try
+	{
+		auto e = a + b - a * 2;
+		if (typeid(e(0, 0)) != typeid(double))
+			return WA("expression type");
+		Matrix<double> c = e;
+		for (std::size_t i = 0; i < 2; ++i)
+			for (std::size_t j = 0; j < 3; ++j)
+				if (c(i, j) != a(i, j) + b(i, j) - a(i, j) * 2)
+					return WA("fused + / - / *");
+		// temporaries are kept alive by the expression
+		auto f = Matrix<int>(2, 3, 1) + a;
+		if (f(1, 2) != 7)
+			return WA("temporary operand");
+		Matrix<int> d = a;
+		d = d * 3 - d;
+		if (d != 2 * a)
+			return WA("aliased assignment");
+		d += a - a * 2;
+		if (d != a)
+			return WA("+= expression");
+		Matrix<int> m = (a + a) * Matrix<int>(a - 2 * a).tran();
+		if (m != -2 * (a * a.tran()))
+			return WA("* on expressions");
+	} catch (...)
+	{
+		return RE("expressions");
+	}
+	bool thrown = false;
+	try
+	{
+		Matrix<int> c(3, 2);
+		Matrix<int> e = a + c * 2;
+	} catch (const std::invalid_argument &msg)
+	{
+		thrown = true;
+	} catch (...)
+	{
+		return RE("expressions");
+	}
+	if (!thrown)
+		return WA("expression shape check");
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testViews()
+{
+	Matrix<int> a = {{ 0,  1,  2,  3 },
+					 { 4,  5,  6,  7 },
+					 { 8,  9,  10, 11 },
+					 { 12, 13, 14, 15 }};
+	try
+	{
+		auto r = a.rowView(1);
+		if (r.size() != std::make_pair((std::size_t) 1, (std::size_t) 4) || r(0, 2) != 6)
+			return WA("rowView");
+		r(0, 2) = 60;
+		if (a(1, 2) != 60)
+			return WA("rowView write");
+		r(0, 2) = 6;
+		auto c = a.columnView(2);
+		if (c(3, 0) != 14 || Matrix<int>(c) != a.column(2))
+			return WA("columnView");
+		const Matrix<int> b = a.block(1, 1, 2, 3);
+		if (b != Matrix<int>({{ 5, 6, 7 }, { 9, 10, 11 }}))
+			return WA("block");
+		if (a.block(1, 1, 2, 3) + b != 2 * b)
+			return WA("view +");
+
+		Matrix<int> d = a;
+		d.block(0, 0, 2, 2) = d.block(2, 2, 2, 2);
+		d.rowView(3) += a.rowView(0);
+		d.columnView(0) *= 2;
+		if (d != Matrix<int>({{ 20, 11, 2, 3 }, { 28, 15, 6, 7 }, { 16, 9, 10, 11 }, { 24, 14, 16, 18 }}))
+			return WA("assignment through views");
+
+		// overlapping source and destination
+		d = a;
+		d.block(1, 0, 3, 4) = d.block(0, 0, 3, 4);
+		if (d.block(1, 0, 3, 4) != a.block(0, 0, 3, 4) || d.rowView(0) != a.rowView(0))
+			return WA("overlapping views");
+
+		// products on strided operands, written into a block
+		Matrix<int> big(40, 50);
+		for (std::size_t i = 0; i < big.Size(); ++i)
+			big[i] = int(i % 9) - 4;
+		auto x = big.block(1, 2, 30, 40);
+		auto y = big.block(3, 5, 35, 33);
+		Matrix<int> e(x), f(y.block(0, 0, 35, 33)), out(32, 40);
+		Matrix<int> ref = Matrix<int>(e.block(0, 0, 30, 35)) * f;
+		sjtu::multiply(out.block(1, 2, 30, 33), x.block(0, 0, 30, 35), y);
+		if (Matrix<int>(out.block(1, 2, 30, 33)) != ref || out(0, 0) != 0)
+			return WA("multiply into view");
+		sjtu::multiplyAdd(out.block(1, 2, 30, 33), x.block(0, 0, 30, 35), y);
+		if (out.block(1, 2, 30, 33) != 2 * ref)
+			return WA("multiplyAdd into view");
+	} catch (...)
+	{
+		return RE("views");
+	}
+	bool thrown = false;
+	try
+	{
+		a.block(0, 0, 2, 2) = a.block(0, 0, 3, 3);
+	} catch (const std::invalid_argument &msg)
+	{
+		thrown = true;
+	} catch (...)
+	{
+		return RE("views");
+	}
+	if (!thrown)
+		return WA("view shape check");
+	return { true, "Congratulation!" };
+};
+
+template <class T>
+bool checkTransposed(const Matrix<T> &a, const Matrix<T> &t)
+{
+	if (t.size() != std::make_pair(a.size().second, a.size().first))
+		return false;
+	for (std::size_t i = 0; i < a.rowLength(); ++i)
+		for (std::size_t j = 0; j < a.columnLength(); ++j)
+			if (t(j, i) != a(i, j))
+				return false;
+	return true;
+}
+
+// no default constructor, so it cannot fill scratch buffers
+struct Label
+{
+	int id;
+	explicit Label(int x) : id(x) {}
+};
+
+template <class T>
+bool transposeRoundTrip(std::size_t r, std::size_t c)
+{
+	Matrix<T> a(r, c);
+	for (std::size_t i = 0; i < a.Size(); ++i)
+		a[i] = T(i % 1000) - T(300);
+	if (!checkTransposed(a, Matrix<T>(a.tran())))
+		return false;
+	Matrix<T> b = a;
+	b.transposeInPlace();
+	if (!checkTransposed(a, b))
+		return false;
+	b.transposeInPlace();
+	return b == a;
+}
+
+std::pair<bool, std::string> testTranspose()
+{
+	const std::size_t shapes[][2] = {{ 0, 0 }, { 1, 1 }, { 1, 17 }, { 23, 1 }, { 7, 7 }, { 64, 64 },
+									 { 100, 100 }, { 131, 131 }, { 37, 91 }, { 200, 65 }, { 600, 700 }};
+	for (auto level : { sjtu::simd::NONE, sjtu::simd::SSE4, sjtu::simd::AVX2, sjtu::simd::AVX512 })
+	{
+		sjtu::simd::setLevel(level);
+		for (auto &s : shapes)
+		{
+			if (!transposeRoundTrip<int>(s[0], s[1]))
+				return WA("int transpose");
+			if (!transposeRoundTrip<float>(s[0], s[1]))
+				return WA("float transpose");
+			if (!transposeRoundTrip<double>(s[0], s[1]))
+				return WA("double transpose");
+			if (!transposeRoundTrip<long long>(s[0], s[1]))
+				return WA("long long transpose");
+		}
+	}
+	sjtu::simd::setLevel(sjtu::simd::AVX512);
+	Matrix<std::string> a = {{ "a", "b", "c" }, { "d", "e", "f" }};
+	Matrix<std::string> b = a;
+	b.transposeInPlace();
+	if (!checkTransposed(a, b) || a.tran() != b)
+		return WA("string transpose");
+	Matrix<Label> square(3, 3, Label(0));
+	for (std::size_t i = 0; i < square.Size(); ++i)
+		square[i] = Label(int(i));
+	square.transposeInPlace();
+	if (square(0, 1).id != 3 || square(2, 1).id != 5 || square(1, 1).id != 4)
+		return WA("in-place transpose without a default constructor");
+	return { true, "Congratulation!" };
+};
+
+// counts the bytes it hands out, shared between copies
+template <class T>
+struct CountingAllocator
+{
+	typedef T value_type;
+	std::shared_ptr<long> live;
+
+	CountingAllocator() : live(std::make_shared<long>(0)) {}
+	template <class U>
+	CountingAllocator(const CountingAllocator<U> &o) : live(o.live) {}
+
+	T *allocate(std::size_t n)
+	{
+		*live += long(n * sizeof(T));
+		return std::allocator<T>().allocate(n);
+	}
+	void deallocate(T *p, std::size_t n)
+	{
+		*live -= long(n * sizeof(T));
+		std::allocator<T>().deallocate(p, n);
+	}
+	template <class U>
+	bool operator==(const CountingAllocator<U> &o) const { return live == o.live; }
+	template <class U>
+	bool operator!=(const CountingAllocator<U> &o) const { return live != o.live; }
+};
+
+std::pair<bool, std::string> testAllocators()
+{
+	Matrix<double> a(37, 41, 1.5);
+	Matrix<float> b(3, 3);
+	Matrix<char> c(1, 1);
+	for (auto p : { (const void *) a.data(), (const void *) b.data(), (const void *) c.data() })
+		if (reinterpret_cast<std::uintptr_t>(p) % 64 != 0)
+			return WA("default alignment");
+
+	// 3 MB: aligned to and padded out to whole huge pages
+	Matrix<double, sjtu::HugePageAllocator<double>> h(512, 768, 2.0);
+	if (reinterpret_cast<std::uintptr_t>(h.data()) % sjtu::HUGE_PAGE_SIZE != 0)
+		return WA("huge page alignment");
+	Matrix<double, sjtu::HugePageAllocator<double>> small(2, 2, 1.0);
+	if (reinterpret_cast<std::uintptr_t>(small.data()) % 64 != 0)
+		return WA("small huge page allocation");
+	Matrix<double> ones(768, 5, 1.0);
+	Matrix<double> hs = h * ones;
+	if (hs != Matrix<double>(512, 5, 1536.0) || h + h != 2 * h)
+		return WA("huge page arithmetic");
+	Matrix<double> plain = h.block(0, 0, 2, 2);
+	if (small + small != plain || !(h.tran() == Matrix<double>(768, 512, 2.0)))
+		return WA("mixed allocators");
+
+	CountingAllocator<int> counter;
+	{
+		Matrix<int, CountingAllocator<int>> m(10, 10, 1, counter);
+		if (*counter.live != long(100 * sizeof(int)))
+			return WA("custom allocator");
+		Matrix<int, CountingAllocator<int>> n(m);
+		n = m * 3;
+		n = m;
+		Matrix<int, CountingAllocator<int>> moved(std::move(n));
+		if (moved != m || moved.get_allocator() != counter)
+			return WA("custom allocator copy");
+		m.resize(20, 20, 2);
+		if (m(19, 19) != 2 || m(0, 0) != 1)
+			return WA("custom allocator resize");
+	}
+	if (*counter.live != 0)
+		return WA("custom allocator leak");
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testArena()
+{
+	Matrix<double> a(60, 70, 0.5), b(70, 50, 2.0), c(60, 50, 1.0), tmp;
+	Matrix<double> escaped;
+	{
+		sjtu::ScopedArena arena;
+		std::size_t warm = 0;
+		for (int it = 0; it < 50; ++it)
+		{
+			tmp = a * b + c;
+			tmp = Matrix<double>(Matrix<double>(tmp.tran()).tran()) - c;
+			if (it == 0)
+				warm = arena.stats().fresh;
+		}
+		sjtu::ArenaStats st = arena.stats();
+		if (st.fresh != warm || st.reused < 100)
+			return WA("arena reuse");
+		if (st.peak < 2 * 60 * 50 * sizeof(double) || st.current > st.peak)
+			return WA("arena usage");
+		if (tmp != Matrix<double>(60, 50, 70.0))
+			return WA("arena results");
+		{
+			Matrix<double> t(100, 100);
+			if (arena.stats().current < st.current + 100 * 100 * sizeof(double))
+				return WA("arena current");
+		}
+		if (arena.stats().cached < 100 * 100 * sizeof(double))
+			return WA("arena cached");
+		arena.release();
+		if (arena.stats().cached != 0)
+			return WA("arena release");
+		escaped = a * b;  // outlives the arena
+	}
+	if (escaped != Matrix<double>(60, 50, 70.0))
+		return WA("arena escape");
+	escaped.clear();
+	{
+		sjtu::ScopedArena capped(0);
+		Matrix<int> x(10, 10, 1);
+		x = x * x;
+		if (capped.stats().cached != 0 || capped.stats().reused != 0)
+			return WA("arena cap");
+	}
+	return { true, "Congratulation!" };
+};
+
+// counts its constructions; moves may be declared throwing
+template <bool NOEXCEPT_MOVE>
+struct Tracked
+{
+	static int alive, copies, moves;
+	std::string v;
+
+	Tracked(const std::string &s = "") : v(s) { ++alive; }
+	Tracked(const Tracked &o) : v(o.v) { ++alive, ++copies; }
+	Tracked(Tracked &&o) noexcept(NOEXCEPT_MOVE) : v(std::move(o.v)) { ++alive, ++moves; }
+	Tracked &operator=(const Tracked &o) = default;
+	~Tracked() { --alive; }
+	bool operator!=(const Tracked &o) const { return v != o.v; }
+};
+template <bool N> int Tracked<N>::alive = 0;
+template <bool N> int Tracked<N>::copies = 0;
+template <bool N> int Tracked<N>::moves = 0;
+
+// fails on the n-th copy
+struct Fragile
+{
+	static int countdown, alive;
+	Fragile() { ++alive; }
+	Fragile(const Fragile &)
+	{
+		if (--countdown == 0)
+			throw std::runtime_error("copy");
+		++alive;
+	}
+	~Fragile() { --alive; }
+};
+int Fragile::countdown = 0, Fragile::alive = 0;
+
+template <bool N>
+bool growthMoves()
+{
+	typedef Tracked<N> E;
+	{
+		sjtu::Vector<E> v;
+		for (int i = 0; i < 100; ++i)
+			v.push_back(E(std::to_string(i)));
+		E::copies = E::moves = 0;
+		for (int i = 0; i < 100; ++i)
+			v.push_back(v[0]);  // aliases the buffer across a regrowth
+		// growth moves when that cannot throw, and copies otherwise
+		if (N ? E::copies != 100 || E::moves == 0 : E::copies <= 100 || E::moves != 0)
+			return false;
+		for (std::size_t i = 100; i < v.size(); ++i)
+			if (v[i].v != "0")
+				return false;
+		sjtu::Vector<E> w = v;
+		w.resize(3);
+		if (w.size() != 3 || w[2].v != "2")
+			return false;
+		while (v.size())
+			v.pop_back();
+	}
+	return E::alive == 0;
+}
+
+std::pair<bool, std::string> testVector()
+{
+	if (!growthMoves<true>())
+		return WA("noexcept growth");
+	if (!growthMoves<false>())
+		return WA("throwing-move growth");
+
+	sjtu::Vector<double> d;
+	d.assign(1000, 0.0);
+	for (std::size_t i = 0; i < d.size(); ++i)
+		if (d[i] != 0.0)
+			return WA("zero assign");
+	d.assign(10, -0.0);
+	if (d.size() != 10 || !std::signbit(d[9]))
+		return WA("negative zero assign");
+	d.resize(20, 2.5);
+	if (d[19] != 2.5 || d[9] != -0.0 || d.size() != 20)
+		return WA("resize");
+	sjtu::Vector<int> small;
+	small.resize(3, 7);
+	const int *kept = small.data();
+	small.resize(5, 8);
+	if (small.data() != kept || small.size() != 5 || small[2] != 7 || small[4] != 8)
+		return WA("resize within capacity");
+	sjtu::Vector<double> e(d);
+	if (!(e == d))
+		return WA("copy");
+	Matrix<long long> z(300, 300);
+	for (std::size_t i = 0; i < z.Size(); ++i)
+		if (z[i] != 0)
+			return WA("zero matrix");
+
+	Fragile::countdown = 5;
+	try
+	{
+		sjtu::Vector<Fragile> f(10);
+		sjtu::Vector<Fragile> g(f);
+		return WA("copy should throw");
+	} catch (const std::runtime_error &)
+	{
+	}
+	if (Fragile::alive != 0)
+		return WA("rollback after throw");
+	return { true, "Congratulation!" };
+};
+
+constexpr sjtu::FixedMatrix<int, 2, 2> fib(unsigned n)
+{
+	sjtu::FixedMatrix<int, 2, 2> r = sjtu::FixedMatrix<int, 2, 2>::identity(), q = {{ 1, 1 }, { 1, 0 }};
+	for (; n; n >>= 1, q = q * q)
+		if (n & 1)
+			r = r * q;
+	return r;
+}
+
+std::pair<bool, std::string> testFixed()
+{
+	using sjtu::FixedMatrix;
+	static_assert(fib(10).get<0, 1>() == 55, "constexpr power");
+	constexpr FixedMatrix<int, 2, 3> a = {{ 1, 2, 3 }, { 4, 5, 6 }};
+	static_assert(a.tran().tran() == a && a.tran()(2, 1) == 6, "constexpr transpose");
+	static_assert((a + a - a) * 2 == 2 * a && -a + a == FixedMatrix<int, 2, 3>(), "constexpr arithmetic");
+	static_assert(!(a == a.tran()) && a != a.tran(), "shape mismatch compares unequal");
+	static_assert(sizeof(FixedMatrix<double, 4, 4>) == 16 * sizeof(double), "inline storage");
+	constexpr FixedMatrix<double, 3, 2> b = {{ 0.5, 1 }, { 1.5, 2 }, { 2.5, 3 }};
+	constexpr auto ab = a * b;
+	static_assert(std::is_same<decltype(ab), const FixedMatrix<double, 2, 2>>::value, "product type");
+	static_assert(ab(0, 0) == 11 && ab(1, 1) == 32, "constexpr product");
+
+	Matrix<int> da(a);
+	Matrix<double> db = b;
+	if (da != Matrix<int>({{ 1, 2, 3 }, { 4, 5, 6 }}) || Matrix<double>(ab) != da * db)
+		return WA("fixed to dynamic");
+	if (!(a * db == ab) || !(da * b == ab) || !(a + da == 2 * da))
+		return WA("mixed fixed and dynamic");
+	FixedMatrix<int, 2, 3> back(da.tran().tran());
+	if (back != a || FixedMatrix<int, 1, 3>(da.rowView(1)) != a.row(1) || a.column(2)(1, 0) != 6)
+		return WA("dynamic to fixed");
+	Matrix<int> out(2, 3);
+	sjtu::multiply(out, a, FixedMatrix<int, 3, 3>::identity());
+	if (out != da)
+		return WA("fixed operands in multiply");
+	FixedMatrix<float, 8, 8> m(1.0f), n;
+	n = m;
+	n *= 2.0f;
+	n += m;
+	n *= FixedMatrix<float, 8, 8>::identity();
+	if (n != FixedMatrix<float, 8, 8>(3.0f))
+		return WA("fixed compound assignment");
+	bool thrown = false;
+	try
+	{
+		FixedMatrix<int, 3, 2> wrong(da);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("fixed shape check");
+	thrown = false;
+	try
+	{
+		a.at(2, 0);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("fixed bounds check");
+	return { true, "Congratulation!" };
+};
+
+template <class T>
+Matrix<T> naiveProduct(const Matrix<T> &a, const Matrix<T> &b)
+{
+	Matrix<T> c(a.rowLength(), b.columnLength(), T(0));
+	for (std::size_t i = 0; i < a.rowLength(); ++i)
+		for (std::size_t p = 0; p < a.columnLength(); ++p)
+			for (std::size_t j = 0; j < b.columnLength(); ++j)
+				c(i, j) += a(i, p) * b(p, j);
+	return c;
+}
+
+std::pair<bool, std::string> testStrassen()
+{
+	const std::size_t shapes[][3] = {{ 64, 64, 64 }, { 129, 77, 100 }, { 97, 131, 65 }, { 40, 300, 41 }, { 200, 33, 180 }};
+	for (auto &s : shapes)
+	{
+		Matrix<long long> a(s[0], s[1]), b(s[1], s[2]);
+		for (std::size_t i = 0; i < a.Size(); ++i)
+			a[i] = (long long)(i * 2654435761u % 1000) - 500;
+		for (std::size_t i = 0; i < b.Size(); ++i)
+			b[i] = (long long)(i * 40503u % 999) - 499;
+		const Matrix<long long> ref = naiveProduct(a, b);
+		for (std::size_t cutoff : { 1, 7, 16, 1000 })
+			if (sjtu::strassenMultiply(a, b, cutoff) != ref)
+				return WA("strassen exact");
+		if (sjtu::strassenMultiply(b.tran().tran().tran(), a.tran(), 8) != ref.tran())
+			return WA("strassen strided operands");
+		Matrix<double> da(a), db(b);
+		Matrix<double> dc = sjtu::strassenMultiply(da * 0.5, db, 10);
+		for (std::size_t i = 0; i < dc.Size(); ++i)
+			if (std::abs(dc[i] - 0.5 * double(ref[i])) > 1e-6 * (1 + std::abs(double(ref[i]))))
+				return WA("strassen floating");
+	}
+
+	// exact types switch over on their own above the threshold
+	const std::size_t threshold = sjtu::strassenThreshold(), cutoff = sjtu::strassenCutoff();
+	sjtu::setStrassenThreshold(50);
+	sjtu::setStrassenCutoff(12);
+	Matrix<int> a(90, 70), b(70, 110), c(90, 110, 5);
+	for (std::size_t i = 0; i < a.Size(); ++i)
+		a[i] = int(i % 17) - 8;
+	for (std::size_t i = 0; i < b.Size(); ++i)
+		b[i] = int(i % 23) - 11;
+	const Matrix<int> ref = naiveProduct(a, b);
+	bool ok = a * b == ref;
+	sjtu::multiply(c, a, b);
+	ok = ok && c == ref;
+	c = Matrix<int>(90, 110, 1);
+	sjtu::multiply(sjtu::MatrixView<int>(c.data(), 110, 90, 1, 110), b.tran(), a.tran());
+	ok = ok && c == ref;
+	sjtu::setStrassenThreshold(threshold);
+	sjtu::setStrassenCutoff(cutoff);
+	if (!ok)
+		return WA("automatic strassen");
+	bool thrown = false;
+	try
+	{
+		sjtu::strassenMultiply(a, a);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("strassen shape check");
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testSparse()
+{
+	using sjtu::CsrMatrix;
+	using sjtu::CscMatrix;
+	const Matrix<double> a = {{ 1, 0, 2, 0 }, { 0, 0, 3, 0 }, { 4, 5, 0, 0 }};
+	CsrMatrix<double> r(a);
+	CscMatrix<double, unsigned> c(a);
+	if (r.nonZeros() != 5 || c.nonZeros() != 5 || r.size() != a.size() || c(2, 1) != 5 || r(1, 3) != 0)
+		return WA("sparse from dense");
+	if (r.toDense() != a || c.toDense() != a || r.tran().toDense() != a.tran() || c.tran().toDense() != a.tran())
+		return WA("sparse to dense");
+	if (CsrMatrix<double, unsigned>(c).toDense() != a || r.toCsc().toDense() != a || c.toCsr().toDense() != a)
+		return WA("csr <-> csc");
+	const unsigned *ptr = c.columnPointers(), *rows = c.rowIndices();
+	if (ptr[1] != 2 || rows[0] != 0 || rows[1] != 2 || c.values()[1] != 4)
+		return WA("csc layout");
+	std::vector<sjtu::Triplet<double>> entries = {{ 2, 1, 5 }, { 0, 2, 1.5 }, { 1, 2, 3 }, { 2, 0, 4 }, { 0, 0, 1 }, { 0, 2, 0.5 }};
+	if (CsrMatrix<double>(3, 4, entries).toDense() != a || CscMatrix<double>(3, 4, entries).toDense() != a)
+		return WA("sparse from triplets");
+
+	// big enough for the threaded paths, vector and matrix right-hand sides
+	const std::size_t n = 3000, m = 2500;
+	std::vector<sjtu::Triplet<long long>> t;
+	for (std::size_t k = 0; k < 40000; ++k)
+		t.push_back({ k * 7919 % n, k * 104729 % m, (long long)(k % 13) - 6 });
+	t.push_back({ n - 1, m - 1, 3 });  // a dense last row
+	for (std::size_t j = 0; j < m; j += 3)
+		t.push_back({ n - 1, j, 1 });
+	CsrMatrix<long long> big(n, m, t);
+	CscMatrix<long long, std::uint32_t> bigc(n, m, t);
+	const Matrix<long long> dense = big.toDense();
+	if (bigc.toDense() != dense)
+		return WA("large triplets");
+	Matrix<long long> x(m, 1), y(m, 37);
+	for (std::size_t i = 0; i < x.Size(); ++i)
+		x[i] = (long long)(i % 11) - 5;
+	for (std::size_t i = 0; i < y.Size(); ++i)
+		y[i] = (long long)(i % 7) - 3;
+	const std::size_t saved = sjtu::ThreadPool::global().size();
+	for (std::size_t threads : { 1, 4 })
+	{
+		sjtu::ThreadPool::setGlobalThreads(threads);
+		const Matrix<long long> dx = dense * x, dy = dense * y;
+		if (big * x != dx || bigc * x != dx)
+			return WA("sparse * vector");
+		if (big * y != dy || bigc * y != dy)
+			return WA("sparse * matrix");
+		if (big * y.tran().tran() != dy || bigc * (y + y) != 2 * dy)
+			return WA("sparse * expression");
+		Matrix<long long> out(1, 1);
+		sjtu::multiply(out, big, y);
+		if (out != dy)
+			return WA("multiply sparse into matrix");
+		Matrix<long long> wide(n, 40, 9);
+		sjtu::multiply(wide.block(0, 2, n, 37), bigc, y);
+		if (wide.block(0, 2, n, 37) != dy || wide(0, 0) != 9)
+			return WA("multiply sparse into view");
+	}
+	// fewer columns than threads: the CSC product goes through the rows
+	sjtu::ThreadPool::setGlobalThreads(8);
+	const Matrix<long long> thin = y.block(0, 0, m, 7);
+	Matrix<long long> framed(n, 9, 9);
+	sjtu::multiply(framed.block(0, 1, n, 7), bigc, thin);
+	if (framed.block(0, 1, n, 7) != dense * thin || framed(n - 1, 8) != 9)
+		return WA("csc * thin matrix");
+	for (std::size_t k = 40000; k < 200000; ++k)
+		t.push_back({ k * 7919 % n, k * 104729 % m, (long long)(k % 5) - 2 });
+	CscMatrix<long long> heavy(n, m, t);
+	if (heavy * x != heavy.toDense() * x)
+		return WA("csc * vector");
+	sjtu::ThreadPool::setGlobalThreads(saved);
+
+	bool thrown = false;
+	try
+	{
+		entries.push_back({ 3, 0, 1 });
+		CsrMatrix<double> bad(3, 4, entries);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("triplet range check");
+	thrown = false;
+	try
+	{
+		r * a;
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("sparse shape check");
+	return { true, "Congratulation!" };
+};
+
+double maxError(const Matrix<double> &a, const Matrix<double> &b)
+{
+	double e = 0;
+	for (std::size_t i = 0; i < a.Size(); ++i)
+		e = std::max(e, std::abs(a[i] - b[i]));
+	return e;
+}
+
+std::pair<bool, std::string> testLU()
+{
+	const Matrix<int> small = {{ 0, 2, 1 }, { 3, 1, 4 }, { 1, 5, 9 }};
+	if (std::abs(sjtu::determinant(small) - (-32.0)) > 1e-9)
+		return WA("determinant");
+	sjtu::LU<double> f(small);
+	if (f.permutation()[0] != 1 || f.singular())
+		return WA("lu pivoting");
+	const Matrix<double> identity = {{ 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }};
+	if (maxError(sjtu::inverse(small), f.inverse()) != 0 || maxError(f.inverse() * Matrix<double>(small), identity) > 1e-12)
+		return WA("inverse");
+
+	// several panels with a ragged last one, and many right-hand sides
+	for (std::size_t n : { 70, 203 })
+	{
+		Matrix<double> a(n, n), b(n, 9);
+		for (std::size_t i = 0; i < a.Size(); ++i)
+			a[i] = double(i * 2654435761u % 1000) / 1000 - 0.5;
+		for (std::size_t i = 0; i < n; ++i)
+			a(i, (i * 3 + 1) % n) += 4;
+		for (std::size_t i = 0; i < b.Size(); ++i)
+			b[i] = double(i % 13) - 6;
+		sjtu::LU<double> lu(a);
+		Matrix<double> pa(n, n);
+		for (std::size_t i = 0; i < n; ++i)
+			pa.rowView(i) = a.rowView(lu.permutation()[i]);
+		Matrix<double> l(n, n, 0), u(n, n, 0);
+		for (std::size_t i = 0; i < n; ++i)
+			for (std::size_t j = 0; j < n; ++j)
+				(j < i ? l : u)(i, j) = lu.packed()(i, j);
+		for (std::size_t i = 0; i < n; ++i)
+			l(i, i) = 1;
+		if (maxError(l * u, pa) > 1e-10)
+			return WA("PA = LU");
+		const Matrix<double> x = lu.solve(b);
+		if (maxError(a * x, b) > 1e-9 || maxError(lu.solve(b.columnView(4)), x.columnView(4)) > 1e-12)
+			return WA("lu solve");
+		Matrix<double> id(n, n, 0);
+		for (std::size_t i = 0; i < n; ++i)
+			id(i, i) = 1;
+		if (maxError(a * lu.inverse(), id) > 1e-9)
+			return WA("lu inverse");
+		if (maxError(sjtu::solve(a.tran(), b), sjtu::LU<double>(a.tran()).solve(b)) != 0)
+			return WA("solve expression");
+	}
+
+	const Matrix<double> singular = {{ 1, 2, 3 }, { 2, 4, 6 }, { 1, 0, 1 }};
+	sjtu::LU<double> s(singular);
+	if (!s.singular() || s.determinant() != 0)
+		return WA("singular matrix");
+	bool thrown = false;
+	try
+	{
+		s.solve(singular);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("singular solve");
+	thrown = false;
+	try
+	{
+		sjtu::LU<double> bad(Matrix<double>(2, 3));
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("lu shape check");
+	return { true, "Congratulation!" };
+};
+
+Matrix<double> randomMatrix(std::size_t n, std::size_t m, unsigned long long seed)
+{
+	Matrix<double> a(n, m);
+	for (std::size_t i = 0; i < a.Size(); ++i)
+	{
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		a[i] = double(seed >> 40) / double(1 << 24) - 0.5;
+	}
+	return a;
+}
+
+std::pair<bool, std::string> testQR()
+{
+	// a line through noisy points, against the normal equations
+	const Matrix<double> x = {{ 1, 0 }, { 1, 1 }, { 1, 2 }, { 1, 3 }};
+	const Matrix<double> y = {{ 1 }, { 3 }, { 5 }, { 7.5 }};
+	const Matrix<double> fit = sjtu::lstsq(x, y);
+	if (maxError(fit, sjtu::solve(x.tran() * x, x.tran() * y)) > 1e-12 || std::abs(fit(1, 0) - 2.15) > 1e-12)
+		return WA("line fit");
+
+	const std::size_t shapes[][2] = {{ 300, 70 }, { 130, 130 }, { 50, 90 }, { 1, 1 }};
+	for (auto &s : shapes)
+	{
+		const Matrix<double> a = randomMatrix(s[0], s[1], s[0] + s[1]);
+		sjtu::QR<double> qr(a, sjtu::QrMode::BLOCKED);
+		const Matrix<double> q = qr.Q(), r = qr.R();
+		const std::size_t k = std::min(s[0], s[1]);
+		Matrix<double> id(k, k, 0);
+		for (std::size_t i = 0; i < k; ++i)
+			id(i, i) = 1;
+		if (q.rowLength() != s[0] || r.rowLength() != k || maxError(q.tran() * q, id) > 1e-12 || maxError(q * r, a) > 1e-12)
+			return WA("A = QR");
+		for (std::size_t i = 0; i < k; ++i)
+			for (std::size_t j = 0; j < i; ++j)
+				if (r(i, j) != 0)
+					return WA("R upper triangular");
+	}
+
+	// tall and skinny: TSQR has to agree with the plain factorization
+	const Matrix<double> a = randomMatrix(3000, 40, 7), b = randomMatrix(3000, 3, 8);
+	sjtu::QR<double> plain(a, sjtu::QrMode::BLOCKED);
+	const Matrix<double> ref = plain.solve(b);
+	if (maxError(a.tran() * (a * ref - b), Matrix<double>(40, 3, 0)) > 1e-10)
+		return WA("least squares residual");
+	const std::size_t saved = sjtu::ThreadPool::global().size();
+	for (std::size_t threads : { 1, 4 })
+	{
+		sjtu::ThreadPool::setGlobalThreads(threads);
+		sjtu::QR<double> tsqr(a, sjtu::QrMode::TSQR);
+		if (tsqr.rowBlocks() < 2 || maxError(tsqr.solve(b), ref) > 1e-10)
+			return WA("tsqr solve");
+		const Matrix<double> q = tsqr.Q(), r = tsqr.R();
+		if (maxError(q * r, a) > 1e-12 || q.columnLength() != 40)
+			return WA("tsqr A = QR");
+		for (std::size_t i = 0; i < 40; ++i)
+			if (std::abs(std::abs(r(i, i)) - std::abs(plain.R()(i, i))) > 1e-10)
+				return WA("tsqr R");
+	}
+	sjtu::ThreadPool::setGlobalThreads(saved);
+	const Matrix<double> tall = randomMatrix(40000, 12, 9);
+	if (sjtu::QR<double>(a).rowBlocks() != 1 || sjtu::QR<double>(tall).rowBlocks() < 2)
+		return WA("automatic tsqr");
+	if (maxError(sjtu::lstsq(tall, tall.columnView(3)), sjtu::QR<double>(tall, sjtu::QrMode::BLOCKED).solve(tall.columnView(3))) > 1e-10)
+		return WA("tall least squares");
+
+	bool thrown = false;
+	try
+	{
+		sjtu::lstsq(x.tran(), Matrix<double>(2, 1));
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("wide least squares");
+	thrown = false;
+	try
+	{
+		sjtu::lstsq(Matrix<double>(5, 2, 1), y);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("least squares shape check");
+	thrown = false;
+	try
+	{
+		sjtu::lstsq(Matrix<double>({{ 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 }}), y);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("rank-deficient least squares");
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testPow()
+{
+	const Matrix<long long> fib = {{ 1, 1 }, { 1, 0 }};
+	if (sjtu::pow(fib, 0) != Matrix<long long>({{ 1, 0 }, { 0, 1 }}) || sjtu::pow(fib, 1) != fib)
+		return WA("trivial powers");
+	if (sjtu::pow(fib, 90)(0, 1) != 2880067194370816120LL || sjtu::pow(fib.tran(), 10)(0, 0) != 89)
+		return WA("fibonacci");
+	// a 3-cycle comes back to itself every third power
+	const Matrix<int> cycle = {{ 0, 1, 0 }, { 0, 0, 1 }, { 1, 0, 0 }};
+	if (sjtu::pow(cycle, 1000000000000000000ULL) != cycle || sjtu::pow(cycle, ~0ULL) != Matrix<int>(sjtu::pow(cycle, 0)))
+		return WA("huge exponents");
+
+	Matrix<long long> a(40, 40);
+	for (std::size_t i = 0; i < a.Size(); ++i)
+		a[i] = (long long)(i % 5) - 2;
+	std::vector<Matrix<long long>> ref(1, Matrix<long long>(40, 40, 0));
+	for (std::size_t i = 0; i < 40; ++i)
+		ref[0](i, i) = 1;
+	for (std::size_t k = 1; k <= 13; ++k)
+		ref.push_back(naiveProduct(ref.back(), a));
+	const std::vector<std::uint64_t> ks = { 13, 0, 6, 1, 8, 6 };
+	const std::vector<Matrix<long long>> batch = sjtu::pow(a, ks);
+	if (batch.size() != ks.size())
+		return WA("batched power count");
+	for (std::size_t i = 0; i < ks.size(); ++i)
+		if (batch[i] != ref[ks[i]] || sjtu::pow(a, ks[i]) != ref[ks[i]])
+			return WA("batched powers");
+	bool thrown = false;
+	try
+	{
+		sjtu::pow(Matrix<int>(2, 3), 2);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("power shape check");
+	return { true, "Congratulation!" };
+};
+
+Matrix<long long> naiveModProduct(const Matrix<long long> &a, const Matrix<long long> &b, long long m)
+{
+	Matrix<long long> c(a.rowLength(), b.columnLength(), 0);
+	for (std::size_t i = 0; i < a.rowLength(); ++i)
+		for (std::size_t p = 0; p < a.columnLength(); ++p)
+			for (std::size_t j = 0; j < b.columnLength(); ++j)
+				c(i, j) = (c(i, j) + (a(i, p) % m + m) % m * ((b(p, j) % m + m) % m)) % m;
+	return c;
+}
+
+std::pair<bool, std::string> testModular()
+{
+	typedef sjtu::ModInt<1000000007> Mint;
+	if (Mint(-1).value() != 1000000006 || (Mint(500000004) * Mint(2)).value() != 1 || (Mint(3) - Mint(5)).value() != 1000000005 || -Mint(0) != Mint(0))
+		return WA("modint arithmetic");
+
+	Matrix<long long> a(70, 90), b(90, 130);
+	for (std::size_t i = 0; i < a.Size(); ++i)
+		a[i] = (long long)(i * 2654435761u % 2000000000u) - 1000000000;
+	for (std::size_t i = 0; i < b.Size(); ++i)
+		b[i] = (long long)(i * 40503u % 1999999999u) - 999999999;
+	Matrix<Mint> ma(70, 90), mb(90, 130);
+	for (std::size_t i = 0; i < a.Size(); ++i)
+		ma[i] = Mint(a[i]);
+	for (std::size_t i = 0; i < b.Size(); ++i)
+		mb[i] = Mint(b[i]);
+	const Matrix<long long> ref = naiveModProduct(a, b, 1000000007);
+	const sjtu::simd::Level saved = sjtu::simd::level();
+	for (int lv = sjtu::simd::NONE; lv <= sjtu::simd::AVX512; ++lv)
+	{
+		sjtu::simd::setLevel(sjtu::simd::Level(lv));
+		const Matrix<Mint> mc = ma * mb;
+		for (std::size_t i = 0; i < ref.Size(); ++i)
+			if (mc[i].value() != ref[i])
+				return WA("modint product");
+		if (Matrix<Mint>(mb.tran() * ma.tran()) != mc.tran())
+			return WA("modint strided product");
+		Matrix<Mint> acc(70, 130, Mint(5));
+		sjtu::multiplyAdd(acc, ma, mb);
+		if (acc != mc + Matrix<Mint>(70, 130, Mint(5)))
+			return WA("modint multiplyAdd");
+		if (sjtu::multiplyMod(a, b, 1000000007) != ref)
+			return WA("runtime modulus");
+		for (long long m : { 1LL, 2LL, 998244353LL, 2147483647LL })
+			if (sjtu::multiplyMod(a, b, m) != naiveModProduct(a, b, m))
+				return WA("runtime moduli");
+	}
+	sjtu::simd::setLevel(saved);
+	if (sjtu::stats::enabled)
+	{
+		Matrix<Mint> p(40, 40);
+		for (std::size_t i = 0; i < p.Size(); ++i)
+			p[i] = Mint(i * 7 + 1);
+		sjtu::pow(p, 3);
+		sjtu::stats::reset();
+		sjtu::pow(p, 3);
+		const std::uint64_t few = sjtu::stats::snapshot().vector.allocations;
+		sjtu::stats::reset();
+		sjtu::pow(p, (1ULL << 40) - 1);
+		if (sjtu::stats::snapshot().vector.allocations != few)
+			return WA("modint pow allocates per product");
+	}
+
+	// exact, so big ModInt products may go through Strassen-Winograd
+	const std::size_t threshold = sjtu::strassenThreshold(), cutoff = sjtu::strassenCutoff();
+	sjtu::setStrassenThreshold(64);
+	sjtu::setStrassenCutoff(16);
+	Matrix<Mint> sa(96, 96), sb(96, 96);
+	for (std::size_t i = 0; i < sa.Size(); ++i)
+	{
+		sa[i] = Mint(i * i + 7);
+		sb[i] = Mint(-(long long)i * 31);
+	}
+	const Matrix<Mint> fast = sa * sb;
+	sjtu::setStrassenThreshold(threshold);
+	sjtu::setStrassenCutoff(cutoff);
+	if (fast != sa * sb)
+		return WA("modint strassen");
+
+	bool thrown = false;
+	try
+	{
+		sjtu::multiplyMod(a, b, 1LL << 31);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("modulus range check");
+	thrown = false;
+	try
+	{
+		sjtu::multiplyMod(a, a, 7);
+	} catch (const std::invalid_argument &)
+	{
+		thrown = true;
+	}
+	if (!thrown)
+		return WA("modular shape check");
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testBounds()
+{
+	Matrix<int> a(3, 4, 1);
+	const Matrix<int> &ca = a;
+	a.at(2, 3) = 5;
+	if (ca.at(2, 3) != 5 || a.at(11) != 5 || a.view().at(2, 3) != 5 || a(2, 3) != 5 || a[11] != 5)
+		return WA("at");
+	int thrown = 0;
+	const std::function<void()> bad[] = {[&] { a.at(3, 0); }, [&] { ca.at(0, 4); }, [&] { a.at(12); }, [&] { a.block(1, 1, 2, 2).at(2, 0); }, [&] { sjtu::FixedMatrix<int, 2, 2>().at(0, 2); }};
+	for (auto &f : bad)
+	{
+		try
+		{
+			f();
+		} catch (const std::invalid_argument &)
+		{
+			++thrown;
+		}
+	}
+	if (thrown != 5)
+		return WA("at always checks");
+	// operator() and operator[] follow the build
+	thrown = 0;
+	try
+	{
+		if (SJTU_MATRIX_CHECK_BOUNDS)
+			a(3, 0);
+	} catch (const std::invalid_argument &)
+	{
+		++thrown;
+	}
+	try
+	{
+		if (SJTU_MATRIX_CHECK_BOUNDS)
+			a[12];
+	} catch (const std::invalid_argument &)
+	{
+		++thrown;
+	}
+	if (thrown != 2 * SJTU_MATRIX_CHECK_BOUNDS)
+		return WA("bounds check policy");
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testIterators()
+{
+	Matrix<int> a(4, 5);
+	for (size_t i = 0; i < a.Size(); ++i)
+		a[i] = int(a.Size() - i);
+	std::sort(a.begin(), a.end());
+	for (size_t i = 0; i < a.Size(); ++i)
+		if (a[i] != int(i + 1))
+			return WA("sort");
+	if (std::accumulate(a.begin(), a.end(), 0) != 210 || a.end() - a.begin() != 20)
+		return WA("accumulate");
+	// reverse the middle 2x3 block only
+	auto sub = a.subMatrix({1, 1}, {2, 3});
+	if (sub.second - sub.first != 6 || std::distance(sub.first, sub.second) != 6)
+		return WA("subMatrix distance");
+	std::reverse(sub.first, sub.second);
+	const int expect[] = {1, 2, 3, 4, 5, 6, 14, 13, 12, 10, 11, 9, 8, 7, 15, 16, 17, 18, 19, 20};
+	for (size_t i = 0; i < a.Size(); ++i)
+		if (a[i] != expect[i])
+			return WA("subMatrix reverse");
+	std::sort(sub.first, sub.second);
+	if (a(1, 1) != 7 || a(1, 3) != 9 || a(2, 1) != 12 || a(2, 3) != 14 || a(1, 4) != 10 || a(2, 0) != 11)
+		return WA("subMatrix sort");
+	auto it = sub.first + 4;
+	if (*it != 13 || it[-3] != 8 || *(2 + sub.first) != 9 || *(it - 4) != 7 || sub.second[-1] != 14)
+		return WA("random access");
+	if (!(sub.first < it && it <= sub.second && it - sub.first == 4 && sub.first - it == -4))
+		return WA("compare");
+	--it, it -= 2;
+	if (*it-- != 8 || *it != 7 || it != sub.first)
+		return WA("decrement");
+	const Matrix<int> &ca = a;
+	Matrix<int>::const_iterator cit = a.begin();
+	if (cit != ca.cbegin() || ca.cend() - cit != 20 || *std::max_element(ca.begin(), ca.end()) != 20)
+		return WA("const_iterator");
+	auto csub = ca.subMatrix({3, 2}, {3, 4});
+	if (std::accumulate(csub.first, csub.second, 0) != 57)
+		return WA("const subMatrix");
+	try
+	{
+		a.subMatrix({0, 0}, {4, 0});
+		return WA("subMatrix out of range");
+	} catch (const std::invalid_argument &)
+	{
+	}
+	static_assert(std::is_same<std::iterator_traits<Matrix<int>::iterator>::iterator_category, std::random_access_iterator_tag>::value, "category");
+	Matrix<int> e;
+	if (e.begin() != e.end())
+		return WA("empty");
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testFile()
+{
+	const std::string path = "/tmp/sjtu_matrix_test_" + std::to_string(getpid()) + ".bin";
+	Matrix<double> a = randomMatrix(37, 53, 11);
+	sjtu::save(path, a);
+	{
+		auto m = sjtu::load<double>(path, true);
+		if (m.size() != a.size() || Matrix<double>(m.view()) != a || m(36, 52) != a(36, 52))
+			return WA("save and load");
+		if (reinterpret_cast<std::uintptr_t>(m.data()) % 64 != 0)
+			return WA("aligned elements");
+		sjtu::MappedMatrix<double> moved = std::move(m);
+		if (m.data() != nullptr || moved.view() * Matrix<double>(53, 1, 1.0) != a * Matrix<double>(53, 1, 1.0))
+			return WA("move");
+	}
+	// expressions are evaluated first, empty matrices round-trip
+	Matrix<int> b(3, 5);
+	for (size_t i = 0; i < b.Size(); ++i)
+		b[i] = int(i) - 7;
+	sjtu::save(path, b.tran());
+	if (Matrix<int>(sjtu::load<int>(path).view()) != Matrix<int>(b.tran()))
+		return WA("save an expression");
+	sjtu::save(path, Matrix<float>());
+	if (sjtu::load<float>(path, true).Size() != 0)
+		return WA("empty");
+	// damaged files
+	sjtu::save(path, b);
+	int thrown = 0;
+	const std::function<void()> bad[] = {[&] { sjtu::load<unsigned>(path); }, [&] { sjtu::load<long long>(path); }, [&] { sjtu::load<int>(path + ".missing"); }};
+	for (auto &f : bad)
+	{
+		try
+		{
+			f();
+		} catch (const std::runtime_error &)
+		{
+			++thrown;
+		}
+	}
+	if (thrown != 3)
+		return WA("wrong type or missing file");
+	std::FILE *f = std::fopen(path.c_str(), "r+b");
+	std::fseek(f, 64 + 9 * sizeof(int), SEEK_SET);
+	std::fputc(0x55, f);
+	std::fclose(f);
+	if (sjtu::load<int>(path).at(1, 4) == b(1, 4))
+		return WA("load without verify");
+	try
+	{
+		sjtu::load<int>(path, true);
+		return WA("checksum");
+	} catch (const std::runtime_error &)
+	{
+	}
+	if (truncate(path.c_str(), 64 + sizeof(int) * 14) != 0)
+		return RE("truncate");
+	try
+	{
+		sjtu::load<int>(path);
+		return WA("truncated");
+	} catch (const std::runtime_error &)
+	{
+	}
+	std::remove(path.c_str());
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testOutOfCore()
+{
+	const std::string base = "/tmp/sjtu_matrix_ooc_" + std::to_string(getpid());
+	const std::string pa = base + "_a.bin", pb = base + "_b.bin", pc = base + "_c.bin";
+	Matrix<double> a = randomMatrix(70, 45, 3), b = randomMatrix(45, 61, 4);
+	sjtu::save(pa, a);
+	sjtu::save(pb, b);
+	const Matrix<double> c = a * b;
+	// from tiles of a few elements up to everything at once
+	for (size_t budget : {48, 1000, 6000, 40000, 1 << 20})
+	{
+		sjtu::multiplyOutOfCore<double>(pa, pb, pc, budget);
+		if (maxError(Matrix<double>(sjtu::load<double>(pc, true).view()), c) > 1e-9)
+			return WA("out-of-core product, budget " + std::to_string(budget));
+	}
+	Matrix<int> x(33, 90), y(90, 17);
+	for (size_t i = 0; i < x.Size(); ++i)
+		x[i] = int(i * 7 % 13) - 6;
+	for (size_t i = 0; i < y.Size(); ++i)
+		y[i] = int(i * 5 % 11) - 5;
+	sjtu::save(pa, x);
+	sjtu::save(pb, y);
+	sjtu::multiplyOutOfCore<int>(pa, pb, pc, 4000);
+	if (Matrix<int>(sjtu::load<int>(pc, true).view()) != x * y)
+		return WA("out-of-core exact product");
+	sjtu::save(pb, Matrix<int>(0, 5));
+	sjtu::save(pa, Matrix<int>(4, 0));
+	sjtu::multiplyOutOfCore<int>(pa, pb, pc, 4000);
+	if (Matrix<int>(sjtu::load<int>(pc, true).view()) != Matrix<int>(4, 5, 0))
+		return WA("empty inner dimension");
+	int thrown = 0;
+	try
+	{
+		sjtu::multiplyOutOfCore<int>(pb, pb, pc, 4000);
+	} catch (const std::invalid_argument &)
+	{
+		++thrown;
+	}
+	try
+	{
+		sjtu::multiplyOutOfCore<int>(pa, pb, pc, 8);
+	} catch (const std::invalid_argument &)
+	{
+		++thrown;
+	}
+	if (thrown != 2)
+		return WA("invalid out-of-core product");
+	std::remove(pa.c_str());
+	std::remove(pb.c_str());
+	std::remove(pc.c_str());
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testText()
+{
+	Matrix<int> a = sjtu::parseText<int>("1 2\t 3\n\n  -4 +5 6  \r\n7 8 9");
+	if (a != Matrix<int>({{1, 2, 3}, {-4, 5, 6}, {7, 8, 9}}))
+		return WA("whitespace");
+	Matrix<double> b = sjtu::parseText<double>("1.5, -2e3 ,3\r\n4,5 , 6.25\n", ',');
+	if (b != Matrix<double>({{1.5, -2000, 3}, {4, 5, 6.25}}) || sjtu::parseText<float>("\n \n").Size() != 0)
+		return WA("csv");
+	const std::pair<const char *, const char *> bad[] = {{"1 2\n3\n", "line 2: rows of different lengths"}, {"1 2\n\n3 x\n", "line 3: expected a number"}, {"1,2,\n", "line 1: expected a number"}, {"1 2;3\n", "line 1: expected a separator"}, {"1\n+-3\n", "line 2: expected a number"}};
+	for (auto &t : bad)
+	{
+		try
+		{
+			sjtu::parseText<int>(t.first, t.first[3] == ',' ? ',' : ' ');
+			return WA(std::string("accepted ") + t.first);
+		} catch (const std::runtime_error &e)
+		{
+			if (e.what() != std::string(t.second))
+				return WA(std::string("error ") + e.what());
+		}
+	}
+	try
+	{
+		sjtu::parseText<signed char>("1 300\n");
+		return WA("accepted 300");
+	} catch (const std::runtime_error &e)
+	{
+		if (e.what() != std::string("line 1: number out of range"))
+			return WA(std::string("error ") + e.what());
+	}
+	// round trips through files big enough to be cut into chunks
+	const std::string path = "/tmp/sjtu_matrix_text_" + std::to_string(getpid()) + ".txt";
+	Matrix<double> x = randomMatrix(400, 300, 5);
+	for (size_t i = 0; i < x.Size(); i += 7)
+		x[i] = x[i] * 1e-300 + 0.1 * double(i);
+	sjtu::writeText(path, x);
+	if (sjtu::readText<double>(path) != x)
+		return WA("round trip");
+	sjtu::writeText(path, x.tran(), ',');
+	if (sjtu::readText<double>(path, ',') != Matrix<double>(x.tran()))
+		return WA("csv round trip");
+	Matrix<long long> y(3, 4);
+	for (size_t i = 0; i < y.Size(); ++i)
+		y[i] = (long long)(i * 1000003) * (i % 2 ? -1 : 1) * (1LL << 30);
+	sjtu::writeText(path, y);
+	if (sjtu::readText<long long>(path) != y)
+		return WA("integer round trip");
+	sjtu::writeText(path, Matrix<int>());
+	if (sjtu::readText<int>(path).Size() != 0)
+		return WA("empty file");
+	std::FILE *f = std::fopen(path.c_str(), "wb");
+	std::fputs("1 2\n3 4\n5\n", f);
+	std::fclose(f);
+	try
+	{
+		sjtu::readText<int>(path);
+		return WA("ragged file");
+	} catch (const std::runtime_error &e)
+	{
+		if (e.what() != path + ":3: rows of different lengths")
+			return WA(std::string("file error ") + e.what());
+	}
+	std::remove(path.c_str());
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testStats()
+{
+	using namespace sjtu::stats;
+	const Matrix<double> a = randomMatrix(20, 30, 1), b = randomMatrix(30, 10, 2);
+	reset();
+	Matrix<double> c = a * b;
+	Matrix<double> d = a + a;
+	d = -(d - a) * 2.0;
+	Matrix<double> e = d.tran();
+	const Snapshot s = snapshot();
+	const OpStats &mul = s.ops[MULTIPLY], &add = s.ops[ADD], &sub = s.ops[SUBTRACT], &scale = s.ops[SCALE];
+	if (enabled)
+	{
+		if (mul.calls != 1 || mul.elements != 200 || mul.flops != 12000 || mul.nanoseconds == 0)
+			return WA("multiply counters");
+		if (add.calls != 1 || add.elements != 600 || scale.calls != 1 || sub.calls != 0 || s.ops[NEGATE].calls != 0 || s.ops[TRANSPOSE].calls != 1)
+			return WA("elementwise counters count the outermost operator");
+		if (s.vector.allocations < 3 || s.vector.bytesAllocated < 1400 * sizeof(double) || report(s).find("multiply") == std::string::npos)
+			return WA("allocation counters");
+		reset();
+		if (snapshot().ops[MULTIPLY].calls != 0)
+			return WA("reset");
+		{
+			sjtu::Vector<std::string> v;
+			const std::string x = "push_back";
+			for (int i = 0; i < 1000; ++i)
+				v.push_back(x);
+		}
+		const AllocStats grown = snapshot().vector;
+		if (grown.reallocations == 0 || grown.allocations != grown.frees || grown.bytesAllocated != grown.bytesFreed)
+			return WA("push_back growth counters");
+		reset();
+		{
+			sjtu::Vector<int> v;
+			v.resize(3);
+			v.resize(5);
+		}
+		const AllocStats resized = snapshot().vector;
+		if (resized.allocations != 1 || resized.reallocations != 0)
+			return WA("resize counters");
+	} else
+	{
+		if (mul.calls != 0 || add.calls != 0 || s.vector.allocations != 0)
+			return WA("counters compiled out");
+	}
+	std::atomic<int> reports(0);
+	{
+		PeriodicReport periodic(std::chrono::milliseconds(1), [&](const Snapshot &) { ++reports; });
+		usleep(20000);
+	}
+	if (reports < 2)
+		return WA("periodic report");
+	return { true, "Congratulation!" };
+};
+
+template <class T>
+bool checkBatch(size_t count, size_t m, size_t k, size_t n)
+{
+	sjtu::MatrixBatch<T> a(count, m, k), b(count, k, n), c(count, m, n);
+	for (size_t q = 0; q < count; ++q)
+	{
+		Matrix<T> x(m, k), y(k, n);
+		for (size_t i = 0; i < x.Size(); ++i)
+			x[i] = T(int((q * 31 + i * 7) % 19) - 9);
+		for (size_t i = 0; i < y.Size(); ++i)
+			y[i] = T(int((q * 17 + i * 5) % 23) - 11);
+		a.set(q, x);
+		b.set(q, y);
+	}
+	const T *end = c.data() + c.packs() * m * n * sjtu::MatrixBatch<T>::LANES;
+	for (int level = sjtu::simd::NONE; level <= sjtu::simd::AVX512; ++level)
+	{
+		sjtu::simd::setLevel(sjtu::simd::Level(level));
+		std::fill(c.data(), (T *) end, T(1));
+		sjtu::multiplyBatch(c, a, b);
+		for (size_t q = 0; q < count; ++q)
+			if (c.get(q) != a.get(q) * b.get(q))
+				return false;
+		// the padding lanes are products of zero matrices
+		for (size_t q = count; q < c.packs() * sjtu::MatrixBatch<T>::LANES; ++q)
+			for (size_t i = 0; i < m * n; ++i)
+				if (c.data()[(q / sjtu::MatrixBatch<T>::LANES * m * n + i) * sjtu::MatrixBatch<T>::LANES + q % sjtu::MatrixBatch<T>::LANES] != T(0))
+					return false;
+	}
+	sjtu::simd::setLevel(sjtu::simd::detected());
+	return true;
+}
+
+std::pair<bool, std::string> testBatch()
+{
+	const size_t shapes[][4] = {{ 37, 3, 3, 3 }, { 100, 5, 4, 7 }, { 9, 16, 16, 16 }, { 1, 2, 9, 1 }, { 20, 13, 6, 11 }};
+	for (auto &s : shapes)
+	{
+		if (!checkBatch<float>(s[0], s[1], s[2], s[3]) || !checkBatch<double>(s[0], s[1], s[2], s[3]))
+			return WA("floating batch " + std::to_string(s[1]) + "x" + std::to_string(s[2]) + "x" + std::to_string(s[3]));
+		if (!checkBatch<int>(s[0], s[1], s[2], s[3]) || !checkBatch<long long>(s[0], s[1], s[2], s[3]))
+			return WA("integer batch " + std::to_string(s[1]) + "x" + std::to_string(s[2]) + "x" + std::to_string(s[3]));
+	}
+	sjtu::MatrixBatch<double> a(10, 3, 4), b(10, 4, 2), c(10, 3, 3), d(9, 3, 2);
+	a(9, 2, 3) = 5;
+	if (a(9, 2, 3) != 5 || a.get(9)(2, 3) != 5 || a.get(8)(2, 3) != 0)
+		return WA("batch element access");
+	int thrown = 0;
+	sjtu::MatrixBatch<double> sq(10, 4, 4);
+	const std::function<void()> bad[] = {[&] { sjtu::multiplyBatch(c, a, b); }, [&] { sjtu::multiplyBatch(d, a, b); }, [&] { a.set(0, Matrix<double>(4, 3)); }, [&] { a.get(10); }, [&] { sjtu::multiplyBatch(sq, sq, sq); }, [&] { sjtu::multiplyBatch(a, a, sq); }};
+	for (auto &f : bad)
+	{
+		try
+		{
+			f();
+		} catch (const std::invalid_argument &)
+		{
+			++thrown;
+		}
+	}
+	if (thrown != 6)
+		return WA("invalid batches");
+	return { true, "Congratulation!" };
+};
+
+std::pair<bool, std::string> testLayout()
+{
+	typedef Matrix<int, sjtu::AlignedAllocator<int>, sjtu::COLUMN_MAJOR> ColumnMajor;
+	const Matrix<double> a = randomMatrix(150, 120, 11), b = randomMatrix(150, 90, 12), c = randomMatrix(120, 150, 13);
+	const auto t = a.tran();
+	if (t.data() != a.data() || t.size() != std::make_pair(std::size_t(120), std::size_t(150)) || t(7, 3) != a(3, 7))
+		return WA("lazy tran");
+	const Matrix<double> at = t;
+	if (!checkTransposed(a, at) || maxError(a.tran() * b, at * b) > 1e-12 || maxError(a * a.tran(), a * at) > 1e-12)
+		return WA("tran operand");
+	if (Matrix<double>(a.tran() + c) != at + c || Matrix<double>(a.tran() * 2.0 - c) != at * 2.0 - c || a.tran() != at)
+		return WA("elementwise tran");
+	Matrix<double> q = randomMatrix(64, 64, 14);
+	const Matrix<double> q0 = q;
+	q = q.tran();
+	if (!checkTransposed(q0, q))
+		return WA("tran aliasing");
+	q = q.tran().tran() - q0.tran();
+	if (q != Matrix<double>(64, 64, 0.0))
+		return WA("tran aliasing");
+	q = q0;
+	q += q.tran();
+	if (maxError(q, q.tran()) != 0 || q(1, 2) != q0(1, 2) + q0(2, 1))
+		return WA("tran aliasing");
+	if (sjtu::stats::enabled)
+	{
+		sjtu::stats::reset();
+		Matrix<double> p = a.tran() * b;
+		if (sjtu::stats::snapshot().ops[sjtu::stats::TRANSPOSE].calls != 0)
+			return WA("tran operand copied");
+	}
+
+	auto moved = Matrix<double>(a).tran();
+	static_assert(std::is_same<decltype(moved), Matrix<double, sjtu::AlignedAllocator<double>, sjtu::COLUMN_MAJOR>>::value, "a temporary transposes into the other layout");
+	if (moved != at || !checkTransposed(a, Matrix<double>(moved)) || Matrix<double>(std::move(moved).tran()) != a)
+		return WA("tran of a temporary");
+
+	ColumnMajor m = {{ 1, 2, 3 }, { 4, 5, 6 }};
+	const int stored[] = { 1, 4, 2, 5, 3, 6 };
+	if (m.layout != sjtu::COLUMN_MAJOR || m(1, 0) != 4 || m.at(0, 2) != 3 || !std::equal(m.begin(), m.end(), stored) || m[3] != 5)
+		return WA("column-major storage");
+	for (int shorter = 0; shorter < 2; ++shorter)
+	{
+		bool thrown = false;
+		try
+		{
+			ColumnMajor ragged = shorter ? ColumnMajor{{ 1, 2, 3 }, { 4, 5 }} : ColumnMajor{{ 1, 2 }, { 4, 5, 6 }};
+		} catch (const std::invalid_argument &)
+		{
+			thrown = true;
+		}
+		if (!thrown)
+			return WA("column-major ragged rows");
+	}
+	const Matrix<int> r = {{ 1, 2, 3 }, { 4, 5, 6 }};
+	if (m != r || !(r == m) || Matrix<int>(m) != r || ColumnMajor(r) != m || m.column(1) != Matrix<int>{{ 2 }, { 5 }} || m.row(1) != r.row(1))
+		return WA("column-major conversions");
+	if (m + r != 2 * r || Matrix<int>(m * m.tran()) != r * r.tran() || m.tran() != r.tran() || !m.tran().contiguous() || m.columnView(2).data() != m.data() + 4)
+		return WA("column-major expressions");
+	auto block = m.subMatrix({ 0, 1 }, { 1, 2 });
+	const int inner[] = { 2, 5, 3, 6 };
+	if (block.second - block.first != 4 || !std::equal(block.first, block.second, inner))
+		return WA("column-major subMatrix");
+	ColumnMajor sum(2, 3);
+	sum = m + m;
+	sum -= r;
+	sum *= 3;
+	m.transposeInPlace();
+	if (sum != 3 * r || m != r.tran() || !std::equal(m.begin(), m.end(), r.begin()))
+		return WA("column-major assignment");
+	Matrix<double, sjtu::AlignedAllocator<double>, sjtu::COLUMN_MAJOR> wide = a;
+	Matrix<double, sjtu::AlignedAllocator<double>, sjtu::COLUMN_MAJOR> e(150, 120);
+	e = wide * 2.0 + wide;
+	if (wide != a || wide.colStride() != 150 || e != a * 3.0 || Matrix<double>(wide.tran()) != at || a.tran().block(5, 10, 20, 30).tran() != a.block(10, 5, 30, 20))
+		return WA("column-major copies");
+	return { true, "Congratulation!" };
+};
+
 struct Int
 {
 	int num;
@@ -455,6 +2058,30 @@ int main()
 	std::pair<std::string, std::function<std::pair<bool, std::string>(void)>> testcases[] = {{ "testCtorAssignment", testCtorAssignment },
 																							 { "testSizeEtc",        testSizeEtc },
 																							 { "testOperations",     testOperations },
+																							 { "testLargeMultiplication", testLargeMultiplication },
+																							 { "testSimdLevels",     testSimdLevels },
+																							 { "testThreadPool",     testThreadPool },
+																							 { "testExpressions",    testExpressions },
+																							 { "testViews",          testViews },
+																							 { "testTranspose",      testTranspose },
+																							 { "testAllocators",     testAllocators },
+																							 { "testArena",          testArena },
+																							 { "testVector",         testVector },
+																							 { "testFixed",          testFixed },
+																							 { "testStrassen",       testStrassen },
+																							 { "testSparse",         testSparse },
+																							 { "testLU",             testLU },
+																							 { "testQR",             testQR },
+																							 { "testPow",            testPow },
+																							 { "testModular",        testModular },
+																							 { "testBounds",         testBounds },
+																							 { "testIterators",      testIterators },
+																							 { "testFile",           testFile },
+																							 { "testOutOfCore",      testOutOfCore },
+																							 { "testText",           testText },
+																							 { "testStats",          testStats },
+																							 { "testBatch",          testBatch },
+																							 { "testLayout",         testLayout },
 																							 { "testIterator",       testIterator },
 																							 { "testPolicyIterator", testPolicyIterator },
 																							 { "testConst",          testConst }};
@@ -0,0 +1,283 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <cstdint>
+#include <algorithm>
+#include <numeric>
+#include "matrix.hpp"
+
+// g++ -std=c++17 -O2 -march=native -pthread Benchmark.cpp -o bench
+// ./bench [--json] [--quick] [--samples N] [--threads N] [--filter TEXT] [--simd none|sse4|avx2|avx512]
+
+using sjtu::Matrix;
+
+// keeps the compiler from dropping the work behind p
+template <class T>
+inline void keep(const T &p)
+{
+	asm volatile("" : : "g"(&p) : "memory");
+}
+
+// indexed by sjtu::simd::Level
+const char *simdNames[] = { "none", "sse4", "avx2", "avx512" };
+
+// the sjtu::simd::Level called name, or -1
+int simdLevel(const std::string &name)
+{
+	for (int i = 0; i < 4; ++i)
+		if (name == simdNames[i])
+			return i;
+	return -1;
+}
+
+struct Options
+{
+	bool json = false, quick = false;
+	size_t samples = 7, threads = 0;
+	int simd = -1;
+	std::string filter;
+};
+
+struct Result
+{
+	std::string name, type, unit;
+	size_t size;
+	double mean, stddev, min, max, seconds;
+	size_t samples, iterations;
+};
+
+/**
+ * Times run() over opt.samples samples after one warm-up call. A sample
+ * repeats run() until it takes long enough to time, and its rate is work
+ * per call over seconds per call; the rates are summarized.
+ */
+Result measure(const Options &opt, const std::string &name, const std::string &type, size_t size, const std::string &unit, double work, const std::function<void()> &run)
+{
+	typedef std::chrono::steady_clock Clock;
+	const double target = opt.quick ? 2e-3 : 2e-2;
+	run();
+	size_t iterations = 1;
+	for (;;)
+	{
+		const Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < iterations; ++i)
+			run();
+		const double t = std::chrono::duration<double>(Clock::now() - start).count();
+		if (t >= target || iterations >= (size_t(1) << 30))
+			break;
+		iterations = t <= 0 ? iterations * 16 : std::max(iterations + 1, size_t(double(iterations) * target * 1.2 / t));
+	}
+	std::vector<double> rates;
+	double seconds = 0;
+	for (size_t s = 0; s < opt.samples; ++s)
+	{
+		const Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < iterations; ++i)
+			run();
+		const double t = std::chrono::duration<double>(Clock::now() - start).count();
+		seconds += t;
+		rates.push_back(work / (std::max(t, 1e-12) / double(iterations)));
+	}
+	Result r;
+	r.name = name, r.type = type, r.unit = unit, r.size = size;
+	r.samples = rates.size(), r.iterations = iterations, r.seconds = seconds;
+	r.mean = std::accumulate(rates.begin(), rates.end(), 0.0) / double(rates.size());
+	double var = 0;
+	for (double x : rates)
+		var += (x - r.mean) * (x - r.mean);
+	r.stddev = rates.size() > 1 ? std::sqrt(var / double(rates.size() - 1)) : 0;
+	r.min = *std::min_element(rates.begin(), rates.end());
+	r.max = *std::max_element(rates.begin(), rates.end());
+	return r;
+}
+
+template <class T>
+Matrix<T> filled(size_t n, size_t m, unsigned seed)
+{
+	Matrix<T> a(n, m);
+	for (size_t i = 0; i < a.Size(); ++i)
+	{
+		seed = seed * 1103515245u + 12345u;
+		a[i] = T(int(seed >> 16 & 1023) - 512) / T(64);
+	}
+	return a;
+}
+
+template <class T>
+void benchType(const Options &opt, const std::string &type, std::vector<Result> &out)
+{
+	const auto wanted = [&](const std::string &name)
+	{
+		return opt.filter.empty() || (name + "/" + type).find(opt.filter) != std::string::npos;
+	};
+	const auto add = [&](const std::string &name, size_t size, const std::string &unit, double work, const std::function<void()> &run)
+	{
+		if (!wanted(name))
+			return;
+		out.push_back(measure(opt, name, type, size, unit, work, run));
+		if (!opt.json)
+		{
+			const Result &r = out.back();
+			std::cout << std::left << std::setw(16) << r.name << std::setw(8) << r.type << std::right << std::setw(9) << r.size << std::fixed << std::setprecision(3) << std::setw(14) << r.mean << " +- " << std::setw(10) << r.stddev << " " << r.unit << std::endl;
+		}
+	};
+	const double bytes = double(sizeof(T)) / 1e9;
+	const std::vector<size_t> gemmSizes = opt.quick ? std::vector<size_t>{ 64, 256 } : std::vector<size_t>{ 64, 128, 256, 512, 1024 };
+	for (size_t n : gemmSizes)
+	{
+		const Matrix<T> a = filled<T>(n, n, 1), b = filled<T>(n, n, 2);
+		Matrix<T> c;
+		add("gemm", n, "GFLOPS", 2e-9 * double(n) * double(n) * double(n), [&]
+		{
+			c = a * b;
+			keep(c);
+		});
+	}
+	const std::vector<size_t> sizes = opt.quick ? std::vector<size_t>{ 64, 512 } : std::vector<size_t>{ 64, 256, 1024, 2048 };
+	for (size_t n : sizes)
+	{
+		const double elements = double(n) * double(n);
+		const Matrix<T> a = filled<T>(n, n, 3), b = filled<T>(n, n, 4);
+		Matrix<T> c(n, n);
+		add("transpose", n, "GB/s", 2 * elements * bytes, [&]
+		{
+			c = a.tran();
+			keep(c);
+		});
+		add("add", n, "GB/s", 3 * elements * bytes, [&]
+		{
+			c = a + b;
+			keep(c);
+		});
+		add("subtract", n, "GB/s", 3 * elements * bytes, [&]
+		{
+			c = a - b;
+			keep(c);
+		});
+		add("scale", n, "GB/s", 2 * elements * bytes, [&]
+		{
+			c = a * T(3);
+			keep(c);
+		});
+		add("fused", n, "GB/s", 3 * elements * bytes, [&]
+		{
+			c = a * T(2) - b + a;
+			keep(c);
+		});
+		add("copy", n, "GB/s", 2 * elements * bytes, [&]
+		{
+			Matrix<T> d(a);
+			keep(d);
+		});
+		Matrix<T> m = a;
+		add("move", n, "Gop/s", 2e-9, [&]
+		{
+			Matrix<T> d(std::move(m));
+			m = std::move(d);
+			keep(m);
+		});
+		add("iterate", n, "GB/s", elements * bytes, [&]
+		{
+			T sum = T();
+			for (const T &x : a)
+				sum += x;
+			keep(sum);
+		});
+		add("iterate-block", n, "GB/s", elements / 4 * bytes, [&]
+		{
+			T sum = T();
+			const auto r = a.subMatrix({ n / 4, n / 4 }, { n / 4 + n / 2 - 1, n / 4 + n / 2 - 1 });
+			for (auto it = r.first; it != r.second; ++it)
+				sum += *it;
+			keep(sum);
+		});
+	}
+	const std::vector<size_t> lengths = opt.quick ? std::vector<size_t>{ 1 << 10, 1 << 18 } : std::vector<size_t>{ 1 << 10, 1 << 16, 1 << 22 };
+	for (size_t n : lengths)
+	{
+		add("vector-resize", n, "GB/s", double(n) * bytes, [&]
+		{
+			sjtu::Vector<T> v;
+			v.resize(n);
+			keep(v);
+		});
+		add("vector-push", n, "GB/s", double(n) * bytes, [&]
+		{
+			sjtu::Vector<T> v;
+			for (size_t i = 0; i < n; ++i)
+				v.push_back(T(i));
+			keep(v);
+		});
+	}
+}
+
+std::string jsonString(const std::string &s)
+{
+	std::string r = "\"";
+	for (char c : s)
+		r += c == '"' || c == '\\' ? std::string("\\") + c : std::string(1, c);
+	return r + "\"";
+}
+
+void printJson(const std::vector<Result> &results)
+{
+	std::ostringstream os;
+	os << std::setprecision(6);
+	os << "{\n  \"simd\": \"" << simdNames[sjtu::simd::level()] << "\",\n  \"threads\": " << sjtu::ThreadPool::global().size() << ",\n  \"results\": [";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const Result &r = results[i];
+		os << (i ? ",\n" : "\n") << "    {\"name\": " << jsonString(r.name) << ", \"type\": " << jsonString(r.type) << ", \"size\": " << r.size << ", \"unit\": " << jsonString(r.unit) << ", \"mean\": " << r.mean << ", \"stddev\": " << r.stddev << ", \"min\": " << r.min << ", \"max\": " << r.max << ", \"samples\": " << r.samples << ", \"iterations\": " << r.iterations << ", \"seconds\": " << r.seconds << "}";
+	}
+	os << "\n  ]\n}\n";
+	std::cout << os.str();
+}
+
+int main(int argc, char **argv)
+{
+	Options opt;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--json")
+			opt.json = true;
+		else if (arg == "--quick")
+			opt.quick = true, opt.samples = 3;
+		else if (arg == "--samples" && i + 1 < argc)
+			opt.samples = std::max(1, std::atoi(argv[++i]));
+		else if (arg == "--threads" && i + 1 < argc)
+			opt.threads = size_t(std::max(1, std::atoi(argv[++i])));
+		else if (arg == "--filter" && i + 1 < argc)
+			opt.filter = argv[++i];
+		else if (arg == "--simd" && i + 1 < argc && (opt.simd = simdLevel(argv[i + 1])) >= 0)
+			++i;
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--json] [--quick] [--samples N] [--threads N] [--filter TEXT] [--simd none|sse4|avx2|avx512]" << std::endl;
+			return 1;
+		}
+	}
+	if (opt.threads)
+		sjtu::ThreadPool::setGlobalThreads(opt.threads);
+	if (opt.simd >= 0)
+	{
+		// kernels the CPU lacks fall back to the best it has
+		sjtu::simd::setLevel(sjtu::simd::Level(opt.simd));
+		if (sjtu::simd::level() != opt.simd)
+			std::cerr << "--simd " << simdNames[opt.simd] << " is not supported here, using " << simdNames[sjtu::simd::level()] << std::endl;
+	}
+	std::vector<Result> results;
+	benchType<float>(opt, "float", results);
+	benchType<double>(opt, "double", results);
+	benchType<int>(opt, "int", results);
+	if (opt.json)
+		printJson(results);
+	return 0;
+}
@@ -1,46 +1,772 @@
 #ifndef SJTU_MATRIX_HPP
 #define SJTU_MATRIX_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
 #include <initializer_list>
 #include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
 #include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using std::max;
 using std::min;
 using std::size_t;
 using std::swap;
 
+// fixed-trip loops that must be fully unrolled, e.g. to keep accumulator
+// tiles in registers
+#define SJTU_UNROLL _Pragma("GCC unroll 16")
+
+/**
+ * Whether element access through operator[] and operator() checks its
+ * indices and throws std::invalid_argument: by default only without
+ * NDEBUG, so release builds index as fast as a raw array. With 0 a bad
+ * index still trips an assert() unless NDEBUG is defined. at() always
+ * checks, and the kernels never go through either.
+ */
+#ifndef SJTU_MATRIX_CHECK_BOUNDS
+#ifdef NDEBUG
+#define SJTU_MATRIX_CHECK_BOUNDS 0
+#else
+#define SJTU_MATRIX_CHECK_BOUNDS 1
+#endif
+#endif
+
+/**
+ * Whether the library counts what it does, see sjtu::stats. Off by
+ * default, in which case the hooks expand to nothing and the counters
+ * are never touched; stats::snapshot() then reads all zeros.
+ */
+#ifndef SJTU_MATRIX_INSTRUMENT
+#define SJTU_MATRIX_INSTRUMENT 0
+#endif
+
 namespace sjtu {
-template <class T, int ALLOCATE_RATIO = 2, size_t MIN_ALLOCATE = 8>
+namespace detail {
+// the check behind operator[] and operator(), see SJTU_MATRIX_CHECK_BOUNDS
+constexpr void checkIndex(bool ok) {
+#if SJTU_MATRIX_CHECK_BOUNDS
+    if (!ok) {
+        throw std::invalid_argument("out of range");
+    }
+#else
+    assert(ok && "out of range");
+    (void)ok;
+#endif
+}
+
+constexpr void checkIndexAlways(bool ok) {
+    if (!ok) {
+        throw std::invalid_argument("out of range");
+    }
+}
+}  // namespace detail
+
+namespace stats {
+// the operations counted, each at its outermost call
+enum Op {
+    MULTIPLY,
+    TRANSPOSE,
+    ADD,
+    SUBTRACT,
+    SCALE,
+    NEGATE,
+    POW,
+    MULTIPLY_MOD,
+    LU,
+    QR,
+    SAVE,
+    LOAD,
+    READ_TEXT,
+    WRITE_TEXT,
+    OUT_OF_CORE,
+    OP_COUNT
+};
+
+inline const char* name(Op op) {
+    static const char* const names[OP_COUNT] = {
+        "multiply", "transpose", "add", "subtract", "scale",
+        "negate", "pow", "multiplyMod", "lu", "qr", "save", "load",
+        "readText", "writeText", "outOfCore"};
+    return names[op];
+}
+
+struct OpStats {
+    std::uint64_t calls;
+    std::uint64_t elements;     // of the results
+    std::uint64_t flops;        // nominal, e.g. 2 m n k for a product
+    std::uint64_t nanoseconds;  // wall time, nested operations included
+};
+
+// storage of every Vector, and so of every Matrix
+struct AllocStats {
+    std::uint64_t allocations;
+    std::uint64_t reallocations;  // growth that moved the elements
+    std::uint64_t frees;
+    std::uint64_t bytesAllocated;
+    std::uint64_t bytesFreed;
+};
+
+struct Snapshot {
+    OpStats ops[OP_COUNT];
+    AllocStats vector;
+};
+
+constexpr bool enabled = SJTU_MATRIX_INSTRUMENT != 0;
+}  // namespace stats
+
+namespace detail {
+struct OpCounters {
+    std::atomic<std::uint64_t> calls, elements, flops, nanoseconds;
+};
+
+struct Counters {
+    OpCounters ops[stats::OP_COUNT];
+    std::atomic<std::uint64_t> allocations, reallocations, frees;
+    std::atomic<std::uint64_t> bytesAllocated, bytesFreed;
+};
+
+// relaxed counters shared by all threads, zero before first use
+inline Counters& counters() {
+    static Counters c;
+    return c;
+}
+
+inline void count(std::atomic<std::uint64_t>& c, std::uint64_t n) {
+    c.fetch_add(n, std::memory_order_relaxed);
+}
+
+// counts one call of op, and its wall time until the end of the scope
+class OpScope {
+    OpCounters& c;
+    std::chrono::steady_clock::time_point start;
+
+   public:
+    OpScope(stats::Op op, std::uint64_t elements, std::uint64_t flops)
+        : c(counters().ops[op]), start(std::chrono::steady_clock::now()) {
+        count(c.calls, 1);
+        count(c.elements, elements);
+        count(c.flops, flops);
+    }
+
+    OpScope(const OpScope&) = delete;
+    OpScope& operator=(const OpScope&) = delete;
+
+    ~OpScope() {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+        count(c.nanoseconds, std::uint64_t(ns.count()));
+    }
+};
+}  // namespace detail
+
+#if SJTU_MATRIX_INSTRUMENT
+#define SJTU_COUNT_OP(op, elements, flops)                                   \
+    const ::sjtu::detail::OpScope sjtuOpScope(                               \
+        op, std::uint64_t(elements), std::uint64_t(flops))
+#define SJTU_COUNT(counter, n)                                               \
+    ::sjtu::detail::count(::sjtu::detail::counters().counter, n)
+#else
+#define SJTU_COUNT_OP(op, elements, flops) ((void)0)
+#define SJTU_COUNT(counter, n) ((void)0)
+#endif
+
+namespace stats {
+inline Snapshot snapshot() {
+    Snapshot s;
+    const detail::Counters& c = detail::counters();
+    const auto get = [](const std::atomic<std::uint64_t>& x) {
+        return x.load(std::memory_order_relaxed);
+    };
+    for (int i = 0; i < OP_COUNT; i++)
+        s.ops[i] = {get(c.ops[i].calls), get(c.ops[i].elements),
+                    get(c.ops[i].flops), get(c.ops[i].nanoseconds)};
+    s.vector = {get(c.allocations), get(c.reallocations), get(c.frees),
+                get(c.bytesAllocated), get(c.bytesFreed)};
+    return s;
+}
+
+inline void reset() {
+    detail::Counters& c = detail::counters();
+    for (int i = 0; i < OP_COUNT; i++)
+        for (auto* x : {&c.ops[i].calls, &c.ops[i].elements, &c.ops[i].flops,
+                        &c.ops[i].nanoseconds})
+            x->store(0, std::memory_order_relaxed);
+    for (auto* x : {&c.allocations, &c.reallocations, &c.frees,
+                    &c.bytesAllocated, &c.bytesFreed})
+        x->store(0, std::memory_order_relaxed);
+}
+
+// one line per operation that was called, then one for Vector storage
+inline std::string report(const Snapshot& s) {
+    std::string out;
+    char line[160];
+    for (int i = 0; i < OP_COUNT; i++) {
+        const OpStats& o = s.ops[i];
+        if (o.calls == 0)
+            continue;
+        std::snprintf(line, sizeof(line),
+                      "%-12s calls %llu elements %llu flops %llu "
+                      "seconds %.6f\n",
+                      name(Op(i)), (unsigned long long)o.calls,
+                      (unsigned long long)o.elements,
+                      (unsigned long long)o.flops, o.nanoseconds * 1e-9);
+        out += line;
+    }
+    std::snprintf(line, sizeof(line),
+                  "%-12s allocations %llu reallocations %llu frees %llu "
+                  "bytes %llu live %lld\n",
+                  "vector", (unsigned long long)s.vector.allocations,
+                  (unsigned long long)s.vector.reallocations,
+                  (unsigned long long)s.vector.frees,
+                  (unsigned long long)s.vector.bytesAllocated,
+                  (long long)(s.vector.bytesAllocated - s.vector.bytesFreed));
+    return out + line;
+}
+
+/**
+ * While alive, hands a snapshot to sink every interval from a thread of
+ * its own, and once more when destroyed; by default the report goes to
+ * stderr.
+ */
+class PeriodicReport {
+   public:
+    explicit PeriodicReport(
+        std::chrono::milliseconds interval,
+        std::function<void(const Snapshot&)> _sink =
+            [](const Snapshot& s) { std::fputs(report(s).c_str(), stderr); })
+        : sink(std::move(_sink)), stopping(false) {
+        worker = std::thread([this, interval] {
+            std::unique_lock<std::mutex> lock(m);
+            while (!cv.wait_for(lock, interval, [this] { return stopping; }))
+                sink(snapshot());
+        });
+    }
+
+    PeriodicReport(const PeriodicReport&) = delete;
+    PeriodicReport& operator=(const PeriodicReport&) = delete;
+
+    ~PeriodicReport() {
+        {
+            std::lock_guard<std::mutex> guard(m);
+            stopping = true;
+        }
+        cv.notify_one();
+        worker.join();
+        sink(snapshot());
+    }
+
+   private:
+    std::function<void(const Snapshot&)> sink;
+    std::mutex m;
+    std::condition_variable cv;
+    bool stopping;
+    std::thread worker;
+};
+}  // namespace stats
+
+// usage of a ScopedArena, in bytes of whole size classes
+struct ArenaStats {
+    size_t current;  // handed out and not yet returned
+    size_t peak;     // the most current has ever been
+    size_t cached;   // returned and kept for reuse
+    size_t reused;   // allocations served from the cache
+    size_t fresh;    // allocations that had to go to the system
+};
+
+namespace detail {
+struct ArenaPool {
+    std::mutex lock;
+    // free blocks by (size class, alignment)
+    std::map<std::pair<size_t, size_t>, std::vector<void*>> bins;
+    ArenaStats stats = {};
+    size_t maxCached = 0;
+    size_t live = 0;
+    bool open = true;
+};
+
+// sits in front of every block from alignedAllocate()
+struct BlockHeader {
+    ArenaPool* pool;
+    size_t bytes;
+};
+
+// the arena that allocations on this thread draw from, if any
+inline ArenaPool*& currentArena() {
+    thread_local ArenaPool* pool = NULL;
+    return pool;
+}
+
+// four classes per power of two, so at most a quarter of a block is waste
+inline size_t sizeClass(size_t bytes) {
+    size_t step = 64;
+    while (step * 8 <= bytes)
+        step *= 2;
+    return (bytes + step - 1) / step * step;
+}
+
+inline size_t headerSpace(size_t align) {
+    return (sizeof(BlockHeader) + align - 1) / align * align;
+}
+
+// frees the blocks cached in pool; the caller holds its lock
+inline void releaseCached(ArenaPool* pool) {
+    for (auto& bin : pool->bins)
+        for (void* base : bin.second)
+            ::operator delete(base, std::align_val_t(bin.first.second));
+    pool->bins.clear();
+    pool->stats.cached = 0;
+}
+
+/**
+ * bytes aligned to align, from the current arena's cache when it has a
+ * block of the right class, else from the system.
+ */
+inline void* alignedAllocate(size_t bytes, size_t align) {
+    ArenaPool* pool = currentArena();
+    const size_t off = headerSpace(align);
+    if (pool == NULL) {
+        BlockHeader* h = static_cast<BlockHeader*>(
+            ::operator new(bytes + off, std::align_val_t(align)));
+        h->pool = NULL;
+        h->bytes = bytes;
+        return reinterpret_cast<char*>(h) + off;
+    }
+    const size_t size = sizeClass(bytes);
+    void* base = NULL;
+    {
+        // one lock for the lookup and all the bookkeeping; a miss is
+        // counted up front and undone if the system allocation throws
+        std::lock_guard<std::mutex> guard(pool->lock);
+        auto it = pool->bins.find(std::make_pair(size, align));
+        if (it != pool->bins.end() && !it->second.empty()) {
+            base = it->second.back();
+            it->second.pop_back();
+            pool->stats.cached -= size;
+            pool->stats.reused++;
+        } else {
+            pool->stats.fresh++;
+        }
+        pool->live++;
+        pool->stats.current += size;
+        pool->stats.peak = max(pool->stats.peak, pool->stats.current);
+    }
+    if (base == NULL) {
+        try {
+            base = ::operator new(size + off, std::align_val_t(align));
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(pool->lock);
+            pool->stats.fresh--;
+            pool->live--;
+            pool->stats.current -= size;
+            throw;
+        }
+    }
+    BlockHeader* h = static_cast<BlockHeader*>(base);
+    h->pool = pool;
+    h->bytes = size;
+    return static_cast<char*>(base) + off;
+}
+
+/**
+ * Gives back a block from alignedAllocate() to its arena, which keeps it
+ * for reuse while it is open and its cache has room. The last block of a
+ * closed arena frees the arena itself.
+ */
+inline void alignedDeallocate(void* p, size_t align) noexcept {
+    void* base = static_cast<char*>(p) - headerSpace(align);
+    const BlockHeader h = *static_cast<BlockHeader*>(base);
+    if (h.pool == NULL) {
+        ::operator delete(base, std::align_val_t(align));
+        return;
+    }
+    bool last = false;
+    {
+        std::lock_guard<std::mutex> guard(h.pool->lock);
+        ArenaStats& st = h.pool->stats;
+        st.current -= h.bytes;
+        h.pool->live--;
+        if (h.pool->open && st.cached + h.bytes <= h.pool->maxCached) {
+            try {
+                h.pool->bins[std::make_pair(h.bytes, align)].push_back(base);
+                st.cached += h.bytes;
+                base = NULL;
+            } catch (...) {
+            }
+        }
+        last = !h.pool->open && h.pool->live == 0;
+    }
+    if (base != NULL)
+        ::operator delete(base, std::align_val_t(align));
+    if (last)
+        delete h.pool;
+}
+}  // namespace detail
+
+/**
+ * Hands out storage aligned to Alignment bytes (at least alignof(T)); the
+ * default of one cache line also covers the widest SIMD registers. Inside
+ * a ScopedArena the storage is recycled.
+ */
+template <class T, size_t Alignment = 64>
+class AlignedAllocator {
+    static constexpr size_t ALIGN = max(Alignment, alignof(T));
+
+   public:
+    typedef T value_type;
+
+    template <class U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() noexcept {}
+    template <class U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n > (size_t(-1) >> 2) / sizeof(T))
+            throw std::bad_array_new_length();
+        return static_cast<T*>(detail::alignedAllocate(n * sizeof(T), ALIGN));
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        detail::alignedDeallocate(p, ALIGN);
+    }
+
+    template <class U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept {
+        return true;
+    }
+    template <class U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept {
+        return false;
+    }
+};
+
+const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+/**
+ * Like AlignedAllocator, but blocks of a huge page or more are aligned to
+ * and padded out to whole huge pages, and on Linux marked for transparent
+ * huge pages, so that large matrices take far fewer TLB entries.
+ */
+template <class T>
+class HugePageAllocator {
+   public:
+    typedef T value_type;
+
+    template <class U>
+    struct rebind {
+        typedef HugePageAllocator<U> other;
+    };
+
+    HugePageAllocator() noexcept {}
+    template <class U>
+    HugePageAllocator(const HugePageAllocator<U>&) noexcept {}
+
+    T* allocate(size_t n) {
+        if (n > (size_t(-1) - HUGE_PAGE_SIZE) / sizeof(T))
+            throw std::bad_array_new_length();
+        if (n * sizeof(T) < HUGE_PAGE_SIZE)
+            return AlignedAllocator<T>().allocate(n);
+        const size_t bytes = roundUp(n * sizeof(T));
+        void* p = ::operator new(bytes, std::align_val_t(HUGE_PAGE_SIZE));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        madvise(p, bytes, MADV_HUGEPAGE);  // only a hint, failure is fine
+#endif
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        if (n * sizeof(T) < HUGE_PAGE_SIZE)
+            AlignedAllocator<T>().deallocate(p, n);
+        else
+            ::operator delete(p, std::align_val_t(HUGE_PAGE_SIZE));
+    }
+
+    template <class U>
+    bool operator==(const HugePageAllocator<U>&) const noexcept {
+        return true;
+    }
+    template <class U>
+    bool operator!=(const HugePageAllocator<U>&) const noexcept {
+        return false;
+    }
+
+   private:
+    static size_t roundUp(size_t bytes) {
+        return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+};
+
+/**
+ * While alive, makes AlignedAllocator on this thread (so every Matrix with
+ * the default allocator, temporaries included) reuse freed blocks of the
+ * same size class instead of going back to the system; a loop with fixed
+ * shapes stops allocating after its first iteration. Blocks still in use
+ * when the arena ends are freed normally later. Must be destroyed on the
+ * thread that created it, innermost first.
+ */
+class ScopedArena {
+   public:
+    explicit ScopedArena(size_t maxCachedBytes = size_t(-1))
+        : pool(new detail::ArenaPool), previous(detail::currentArena()) {
+        pool->maxCached = maxCachedBytes;
+        detail::currentArena() = pool;
+    }
+
+    ScopedArena(const ScopedArena&) = delete;
+    ScopedArena& operator=(const ScopedArena&) = delete;
+
+    ~ScopedArena() {
+        detail::currentArena() = previous;
+        bool last;
+        {
+            std::lock_guard<std::mutex> guard(pool->lock);
+            detail::releaseCached(pool);
+            pool->open = false;
+            last = pool->live == 0;
+        }
+        if (last)
+            delete pool;
+    }
+
+    ArenaStats stats() const {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        return pool->stats;
+    }
+
+    // returns the cached blocks to the system
+    void release() {
+        std::lock_guard<std::mutex> guard(pool->lock);
+        detail::releaseCached(pool);
+    }
+
+   private:
+    detail::ArenaPool* pool;
+    detail::ArenaPool* previous;
+};
+
+/**
+ * Elements live in [0, size()) of storage for capacity() of them; the
+ * rest is raw memory. Trivially copyable T is moved with memcpy and
+ * zero-filled with memset, anything else is constructed in place and
+ * moved on growth when its move cannot throw.
+ */
+template <class T,
+          int ALLOCATE_RATIO = 2,
+          size_t MIN_ALLOCATE = 8,
+          class Allocator = AlignedAllocator<T>>
 class Vector {
+    template <class U, int, size_t, class>
+    friend class Vector;
+
+    typedef std::allocator_traits<Allocator> Traits;
+    static constexpr bool TRIVIAL = std::is_trivially_copyable<T>::value;
+
    private:
     T* Data;
     size_t sz, cap;
+    Allocator alloc;
+
+    // room for n elements, or NULL for none
+    T* allocateRaw(size_t n) {
+        if (n == 0)
+            return NULL;
+        T* p = Traits::allocate(alloc, n);
+        SJTU_COUNT(allocations, 1);
+        SJTU_COUNT(bytesAllocated, n * sizeof(T));
+        return p;
+    }
+
+    void deallocateRaw(T* p, size_t n) {
+        SJTU_COUNT(frees, 1);
+        SJTU_COUNT(bytesFreed, n * sizeof(T));
+        Traits::deallocate(alloc, p, n);
+    }
+
+    void destroy(T* p, size_t n) {
+        if (!std::is_trivially_destructible<T>::value)
+            for (size_t i = 0; i < n; i++)
+                Traits::destroy(alloc, p + i);
+    }
+
+    // destroys the elements and frees the storage
+    void release() {
+        if (Data == NULL)
+            return;
+        destroy(Data, sz);
+        deallocateRaw(Data, cap);
+    }
+
+    // constructs n elements at p by make(q, i), undoing them all on a throw
+    template <class F>
+    void constructEach(T* p, size_t n, F make) {
+        size_t i = 0;
+        try {
+            for (; i < n; i++)
+                make(p + i, i);
+        } catch (...) {
+            destroy(p, i);
+            throw;
+        }
+    }
+
+    static bool zeroBytes(const T& x) {
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(&x);
+        for (size_t i = 0; i < sizeof(T); i++)
+            if (b[i])
+                return false;
+        return true;
+    }
+
+    // n default-initialized elements; trivial ones are left as they are
+    void constructDefault(T* p, size_t n) {
+        if (!std::is_trivially_default_constructible<T>::value)
+            constructEach(p, n,
+                          [&](T* q, size_t) { Traits::construct(alloc, q); });
+    }
+
+    void constructFill(T* p, size_t n, const T& x) {
+        if (TRIVIAL && zeroBytes(x)) {
+            if (n)
+                std::memset(static_cast<void*>(p), 0, n * sizeof(T));
+        } else {
+            constructEach(p, n, [&](T* q, size_t) {
+                Traits::construct(alloc, q, x);
+            });
+        }
+    }
+
+    void constructCopy(T* p, const T* src, size_t n) {
+        if (TRIVIAL) {
+            if (n)
+                std::memcpy(static_cast<void*>(p), src, n * sizeof(T));
+        } else {
+            constructEach(p, n, [&](T* q, size_t i) {
+                Traits::construct(alloc, q, src[i]);
+            });
+        }
+    }
+
+    // moves n elements from src to raw p, leaving src destroyed
+    void relocate(T* p, T* src, size_t n) {
+        if (TRIVIAL) {
+            if (n)
+                std::memcpy(static_cast<void*>(p), src, n * sizeof(T));
+        } else {
+            constructEach(p, n, [&](T* q, size_t i) {
+                Traits::construct(alloc, q, std::move_if_noexcept(src[i]));
+            });
+            destroy(src, n);
+        }
+    }
+
+    // moves to storage for newcap, keeping at most newcap elements
     void reallocate(const size_t& newcap) {
-        T* newData = new T[newcap];
-        sz = min(sz, newcap);
-        for (size_t i = 0; i < sz; i++)
-            newData[i] = Data[i];
-        delete[] Data;
+        T* newData = allocateRaw(newcap);
+        if (sz > newcap) {
+            destroy(Data + newcap, sz - newcap);
+            sz = newcap;
+        }
+        try {
+            relocate(newData, Data, sz);
+        } catch (...) {
+            if (newData)
+                deallocateRaw(newData, newcap);
+            throw;
+        }
+        if (Data) {
+            SJTU_COUNT(reallocations, 1);
+            deallocateRaw(Data, cap);
+        }
         Data = newData;
         cap = newcap;
     }
 
+    // empties the vector and makes sure there is room for exactly n
+    void reserveExactly(size_t n) {
+        destroy(Data, sz);
+        sz = 0;
+        if (cap != n) {
+            if (Data)
+                deallocateRaw(Data, cap);
+            Data = NULL;
+            cap = 0;  // stays consistent if the allocation throws
+            Data = allocateRaw(n);
+            cap = n;
+        }
+    }
+
+    size_t grownCapacity() const {
+        return max(MIN_ALLOCATE, cap * ALLOCATE_RATIO);
+    }
+
    public:
-    Vector() { cap = sz = 0, Data = NULL; }
-    Vector(size_t SZ) {
-        cap = sz = SZ;
-        Data = new T[sz];
+    typedef Allocator allocator_type;
+
+    Vector() : Data(NULL), sz(0), cap(0), alloc() {}
+    explicit Vector(const Allocator& a) : Data(NULL), sz(0), cap(0), alloc(a) {}
+    Vector(size_t SZ, const Allocator& a = Allocator())
+        : Data(NULL), sz(0), cap(0), alloc(a) {
+        Data = allocateRaw(SZ);
+        cap = SZ;
+        try {
+            constructDefault(Data, SZ);
+        } catch (...) {
+            release();
+            throw;
+        }
+        sz = SZ;
     }
-    Vector(const Vector& b) {
+    Vector(const Vector& b)
+        : Data(NULL),
+          sz(0),
+          cap(0),
+          alloc(Traits::select_on_container_copy_construction(b.alloc)) {
+        Data = allocateRaw(b.sz);
+        cap = b.sz;
+        try {
+            constructCopy(Data, b.Data, b.sz);
+        } catch (...) {
+            release();
+            throw;
+        }
         sz = b.sz;
-        cap = sz;
-        Data = new T[sz];
-        for (size_t i = 0; i < sz; i++)
-            Data[i] = b[i];
     }
-    Vector(Vector&& b) {
+    Vector(Vector&& b) noexcept : alloc(std::move(b.alloc)) {
         Data = b.Data;
         cap = b.cap;
         sz = b.sz;
@@ -48,53 +774,87 @@ class Vector {
     }
     void stealedClear() { cap = sz = 0, Data = NULL; }
     template <class U>
-    Vector(const std::initializer_list<std::initializer_list<U>>& il) {
-        sz = 0, cap = il.size() * il.begin()->size();
-        Data = new T[cap];
+    Vector(const std::initializer_list<std::initializer_list<U>>& il,
+           const Allocator& a = Allocator())
+        : Data(NULL), sz(0), cap(0), alloc(a) {
+        Data = allocateRaw(il.size() * il.begin()->size());
+        cap = il.size() * il.begin()->size();
         for (auto& i : il) {
             if (i.size() != il.begin()->size()) {
                 clear();
                 throw std::invalid_argument("invalid initializer list");
             }
             for (auto& j : i) {
-                Data[sz++] = T(j);
+                try {
+                    Traits::construct(alloc, Data + sz, T(j));
+                } catch (...) {
+                    clear();
+                    throw;
+                }
+                sz++;
             }
         }
     }
-    ~Vector() { delete[] Data; }
+    ~Vector() { release(); }
+    allocator_type get_allocator() const { return alloc; }
     size_t size() const { return sz; }
     size_t capacity() const { return cap; }
+    T* data() { return Data; }
+    const T* data() const { return Data; }
     T& operator[](const size_t& i) { return Data[i]; }
     const T& operator[](const size_t& i) const { return Data[i]; }
     void clear() {
-        delete[] Data;
+        release();
         Data = NULL;
         cap = sz = 0;
     }
     void resize(const size_t& newsz, const T _init = T()) {
+        const size_t shrunk = max(MIN_ALLOCATE, cap / ALLOCATE_RATIO);
+        if (newsz < sz) {
+            destroy(Data + newsz, sz - newsz);
+            sz = newsz;
+        }
         if (newsz > cap) {
             reallocate(max(MIN_ALLOCATE, newsz));
-            while (sz < newsz)
-                Data[sz++] = _init;
-        } else if (newsz < max(MIN_ALLOCATE, cap / ALLOCATE_RATIO)) {
+        } else if (newsz < shrunk && shrunk != cap) {
+            reallocate(shrunk);
+        }
+        if (newsz > sz) {
+            constructFill(Data + sz, newsz - sz, _init);
             sz = newsz;
-            reallocate(max(MIN_ALLOCATE, cap / ALLOCATE_RATIO));
         }
     }
     Vector& operator=(const Vector& b) {
         if (Data != b.Data) {
-            delete[] Data;
-            sz = b.size();
-            cap = sz;
-            Data = new T[sz];
-            for (size_t i = 0; i < sz; i++)
-                Data[i] = b[i];
+            if (Traits::propagate_on_container_copy_assignment::value &&
+                !(alloc == b.alloc)) {
+                clear();
+                alloc = b.alloc;
+            }
+            // a big enough buffer is reused as it is
+            if (cap < b.sz || b.sz < cap / ALLOCATE_RATIO) {
+                reserveExactly(b.sz);
+            } else {
+                destroy(Data, sz);
+                sz = 0;
+            }
+            constructCopy(Data, b.Data, b.sz);
+            sz = b.sz;
         }
         return *this;
     }
     Vector& operator=(Vector&& b) {
         if (Data != b.Data) {
-            delete[] Data;
+            if (!Traits::propagate_on_container_move_assignment::value &&
+                !(alloc == b.alloc)) {
+                // b's buffer cannot be freed by our allocator: copy it
+                *this = static_cast<const Vector&>(b);
+                b.clear();
+                return *this;
+            }
+            clear();
+            if (Traits::propagate_on_container_move_assignment::value)
+                alloc = std::move(b.alloc);
             Data = b.Data;
             cap = b.capacity();
             sz = b.size();
@@ -102,8 +862,8 @@ class Vector {
         }
         return *this;
     }
-    template <class U>
-    bool operator==(const Vector<U>& b) const {
+    template <class U, int R, size_t M, class A>
+    bool operator==(const Vector<U, R, M, A>& b) const {
         if (sz != b.size())
             return false;
         for (size_t i = 0; i < sz; i++)
@@ -111,23 +871,59 @@ class Vector {
                 return false;
         return true;
     }
+    // newsz copies of _init; the buffer is kept unless far off in size
     void assign(const size_t& newsz, const T& _init) {
         if (cap < newsz || newsz < cap / ALLOCATE_RATIO) {
-            reallocate(newsz);
+            reserveExactly(newsz);
+        } else {
+            destroy(Data, sz);
+            sz = 0;
         }
+        constructFill(Data, newsz, _init);
         sz = newsz;
-        for (size_t i = 0; i < sz; i++)
-            Data[i] = _init;
     }
-    /** unused **/
     void push_back(const T& x) {
-        if (sz >= cap)
-            reallocate(max(MIN_ALLOCATE, cap * ALLOCATE_RATIO));
-        Data[sz++] = x;
+        if (sz < cap) {
+            Traits::construct(alloc, Data + sz, x);
+        } else {
+            // x may live in the old buffer: construct it before moving
+            const size_t newcap = grownCapacity();
+            T* newData = allocateRaw(newcap);
+            try {
+                Traits::construct(alloc, newData + sz, x);
+            } catch (...) {
+                deallocateRaw(newData, newcap);
+                throw;
+            }
+            try {
+                relocate(newData, Data, sz);
+            } catch (...) {
+                destroy(newData + sz, 1);
+                deallocateRaw(newData, newcap);
+                throw;
+            }
+            if (Data) {
+                SJTU_COUNT(reallocations, 1);
+                deallocateRaw(Data, cap);
+            }
+            Data = newData;
+            cap = newcap;
+        }
+        sz++;
+    }
+    void push_back(T&& x) {
+        if (sz < cap) {
+            Traits::construct(alloc, Data + sz, std::move(x));
+        } else {
+            T tmp(std::move(x));  // x may live in the old buffer
+            reallocate(grownCapacity());
+            Traits::construct(alloc, Data + sz, std::move(tmp));
+        }
+        sz++;
     }
     void pop_back() {
         if (sz > 0) {
-            sz--;
+            destroy(Data + --sz, 1);
             if (sz < max(MIN_ALLOCATE, cap / ALLOCATE_RATIO)) {
                 reallocate(max(MIN_ALLOCATE, cap / ALLOCATE_RATIO));
             }
@@ -135,446 +931,5672 @@ class Vector {
     }
 };
 
-template <class T>
-class Matrix {
-    template <class U>
-    friend class Matrix;
+namespace detail {
+struct ParallelBatch {
+    void (*run)(const void* ctx, size_t i);
+    const void* ctx;
+    std::atomic<size_t> pending;
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    // the last task to finish signals the caller under doneLock
+    std::mutex doneLock;
+    std::condition_variable done;
+};
+
+struct ParallelTask {
+    ParallelBatch* batch;
+    size_t index;
+};
+
+// set while the current thread runs a pool task; nested work runs inline
+inline bool& inParallelRegion() {
+    thread_local bool flag = false;
+    return flag;
+}
+}  // namespace detail
 
+/**
+ * A fixed set of worker threads shared by all Matrix operations. Each
+ * worker owns a task deque: it pops its own tasks from the back and steals
+ * from the front of the others' when it runs dry. The thread calling
+ * parallelFor() works on the tasks too and sleeps once none are left to
+ * steal. A parallelFor() issued from inside a task, or while tasks of
+ * another caller are still queued, runs inline, so the pool adds at most
+ * size() - 1 runnable threads to those of its callers.
+ */
+class ThreadPool {
    private:
-    Vector<T> Data;
-    size_t R, C;
+    struct Queue {
+        std::mutex lock;
+        std::deque<detail::ParallelTask> tasks;
+    };
 
-   public:
-    Matrix() : Data(), R(0), C(0) {}
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    std::atomic<size_t> queued;
+    std::atomic<size_t> nextQueue;
+    bool stopping;
 
-    Matrix(size_t n, size_t m, T _init = T()) : Data(), R(n), C(m) {
-        Data.assign(R * C, _init);
+    bool popBack(size_t q, detail::ParallelTask& t) {
+        std::lock_guard<std::mutex> guard(queues[q]->lock);
+        if (queues[q]->tasks.empty())
+            return false;
+        t = queues[q]->tasks.back();
+        queues[q]->tasks.pop_back();
+        return true;
     }
 
-    explicit Matrix(std::pair<size_t, size_t> sz, T _init = T())
-        : Data(), R(sz.first), C(sz.second) {
-        Data.assign(R * C, _init);
+    bool steal(size_t first, detail::ParallelTask& t) {
+        for (size_t k = 0; k < queues.size(); k++) {
+            Queue& q = *queues[(first + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(q.lock);
+            if (!q.tasks.empty()) {
+                t = q.tasks.front();
+                q.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
     }
 
-    Matrix(const Matrix& o) : Data(o.Data), R(o.R), C(o.C) {}
-
-    template <class U>
-    Matrix(const Matrix<U>& o) : Data(o.R * o.C), R(o.R), C(o.C) {
-        for (size_t i = 0; i < R * C; i++) {
-            Data[i] = T(o[i]);
+    static void execute(const detail::ParallelTask& t) {
+        detail::ParallelBatch* b = t.batch;
+        bool& nested = detail::inParallelRegion();
+        const bool old = nested;
+        nested = true;
+        try {
+            b->run(b->ctx, t.index);
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(b->errorMutex);
+            if (!b->error)
+                b->error = std::current_exception();
         }
+        nested = old;
+        // the caller may destroy *b as soon as it sees pending == 0 under
+        // doneLock, so nothing touches b after the lock is released
+        std::lock_guard<std::mutex> guard(b->doneLock);
+        if (b->pending.fetch_sub(1, std::memory_order_release) == 1)
+            b->done.notify_one();
     }
 
-    Matrix& operator=(const Matrix& o) {
-        R = o.R;
-        C = o.C;
-        Data = o.Data;
-        return *this;
+    void workerLoop(size_t id) {
+        detail::inParallelRegion() = true;
+        detail::ParallelTask t;
+        for (;;) {
+            if (popBack(id, t) || steal(id + 1, t)) {
+                queued.fetch_sub(1);
+                execute(t);
+                continue;
+            }
+            std::unique_lock<std::mutex> lk(sleepLock);
+            wake.wait(lk, [this] { return stopping || queued.load() > 0; });
+            if (stopping && queued.load() == 0)
+                return;
+        }
     }
 
-    template <class U>
-    Matrix& operator=(const Matrix<U>& o) {
-        R = o.R;
-        C = o.C;
-        Data.resize(R * C);
-        for (size_t i = 0; i < R * C; i++) {
-            Data[i] = T(o[i]);
-        }
-        return *this;
+    template <class F>
+    static void invoke(const void* f, size_t i) {
+        (*static_cast<const F*>(f))(i);
     }
 
-    Matrix(Matrix&& o) noexcept {
-        R = o.R;
-        C = o.C;
-        Data = std::move(o.Data);
-        o.Data.stealedClear();
+    static std::unique_ptr<ThreadPool>& globalSlot() {
+        static std::unique_ptr<ThreadPool> pool;
+        return pool;
     }
 
-    Matrix& operator=(Matrix&& o) noexcept {
-        R = o.R;
-        C = o.C;
-        Data = std::move(o.Data);
-        o.Data.stealedClear();
-        return *this;
+   public:
+    // a pool running n tasks at a time: n - 1 workers plus the caller
+    explicit ThreadPool(size_t n) : queued(0), nextQueue(0), stopping(false) {
+        const size_t nworkers = n > 1 ? n - 1 : 0;
+        for (size_t i = 0; i < nworkers; i++)
+            queues.emplace_back(new Queue);
+        for (size_t i = 0; i < nworkers; i++)
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
     }
 
-    ~Matrix() { Data.clear(); }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
 
-    Matrix(std::initializer_list<std::initializer_list<T>> il) {
-        R = il.size();
-        C = il.begin()->size();
-        Data = Vector<T>(il);
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers)
+            w.join();
     }
 
-   public:
-    size_t rowLength() const { return R; }
-
-    size_t columnLength() const { return C; }
+    size_t size() const { return workers.size() + 1; }
 
-    T& operator[](const size_t x) {
-        if (x >= Data.size()) {
-            throw std::invalid_argument("out of range");
+    /**
+     * Calls f(i) for every i in [0, n) and returns once all calls are done.
+     * The first exception thrown by f is rethrown here.
+     */
+    template <class F>
+    void parallelFor(size_t n, const F& f) {
+        if (n == 0)
+            return;
+        if (n == 1 || workers.empty() || detail::inParallelRegion() ||
+            queued.load() > 0) {
+            for (size_t i = 0; i < n; i++)
+                f(i);
+            return;
         }
+        detail::ParallelBatch batch;
+        batch.run = &invoke<F>;
+        batch.ctx = &f;
+        batch.pending.store(n);
+        {
+            std::lock_guard<std::mutex> guard(sleepLock);
+            queued.fetch_add(n);
+        }
+        const size_t first = nextQueue.fetch_add(1);
+        for (size_t i = 0; i < n; i++) {
+            Queue& q = *queues[(first + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(q.lock);
+            q.tasks.push_back(detail::ParallelTask{&batch, i});
+        }
+        wake.notify_all();
+        detail::ParallelTask t;
+        while (batch.pending.load(std::memory_order_acquire) > 0 &&
+               steal(first, t)) {
+            queued.fetch_sub(1);
+            execute(t);
+        }
+        {
+            std::unique_lock<std::mutex> lk(batch.doneLock);
+            batch.done.wait(lk, [&batch] {
+                return batch.pending.load(std::memory_order_acquire) == 0;
+            });
+        }
+        if (batch.error)
+            std::rethrow_exception(batch.error);
+    }
+
+    /**
+     * The pool used by Matrix operations. Its size defaults to the
+     * SJTU_MATRIX_THREADS environment variable, or the number of hardware
+     * threads.
+     */
+    static ThreadPool& global() {
+        static std::once_flag once;
+        std::unique_ptr<ThreadPool>& pool = globalSlot();
+        // first calls from several threads at once build a single pool
+        std::call_once(once, [&pool] {
+            if (pool)
+                return;
+            size_t n = std::thread::hardware_concurrency();
+            if (const char* env = std::getenv("SJTU_MATRIX_THREADS"))
+                n = size_t(std::strtoul(env, NULL, 10));
+            pool.reset(new ThreadPool(max(n, size_t(1))));
+        });
+        return *pool;
+    }
+
+    // resizes the global pool; must not race with running operations
+    static void setGlobalThreads(size_t n) {
+        globalSlot().reset(new ThreadPool(max(n, size_t(1))));
+    }
+};
+
+namespace detail {
+// runs f(begin, end) over [0, n) split into chunks of about grain elements
+template <class F>
+void parallelChunks(size_t n, size_t grain, const F& f) {
+    const size_t chunks = (n + grain - 1) / grain;
+    if (chunks <= 1) {
+        f(size_t(0), n);
+        return;
+    }
+    ThreadPool::global().parallelFor(chunks, [&](size_t i) {
+        f(i * grain, min(n, (i + 1) * grain));
+    });
+}
+
+// elementwise work is memory bound, so it is only split for big arrays
+const size_t ELEMENTWISE_GRAIN = size_t(1) << 16;
+
+/**
+ * Blocking parameters of the packed GEMM, following the usual
+ * GotoBLAS/BLIS scheme: a KC x NC panel of B lives in L3 and an MC x KC
+ * block of A lives in L2. The register tile MR x NR is chosen by the
+ * micro-kernel, see GemmKernel.
+ */
+template <class T>
+struct GemmBlocking {
+    static constexpr size_t KC = 256;
+    static constexpr size_t MC = 96;
+    static constexpr size_t NC = 2048;
+};
+
+// below this many multiply-adds packing costs more than it saves
+const size_t GEMM_MIN_WORK = 32 * 32 * 32;
+
+/**
+ * c[0..m)[0..n) += a * b, where a is a packed mr x kc sliver and b is a
+ * packed kc x nr sliver.
+ */
+template <class T>
+struct GemmKernel {
+    size_t mr, nr;
+    void (*micro)(size_t kc,
+                  const T* a,
+                  const T* b,
+                  T* c,
+                  size_t ldc,
+                  size_t m,
+                  size_t n);
+};
+
+/**
+ * Portable micro-kernel. The accumulator tile is a local array so that
+ * the compiler can keep it in registers.
+ */
+template <class T, size_t MR, size_t NR>
+void gemmMicroKernel(size_t kc,
+                     const T* a,
+                     const T* b,
+                     T* c,
+                     size_t ldc,
+                     size_t m,
+                     size_t n) {
+    T acc[MR][NR];
+    for (size_t i = 0; i < MR; i++)
+        for (size_t j = 0; j < NR; j++)
+            acc[i][j] = T(0);
+    for (size_t p = 0; p < kc; p++, a += MR, b += NR) {
+        for (size_t i = 0; i < MR; i++) {
+            const T ai = a[i];
+            for (size_t j = 0; j < NR; j++)
+                acc[i][j] += ai * b[j];
+        }
+    }
+    if (m == MR && n == NR) {
+        for (size_t i = 0; i < MR; i++)
+            for (size_t j = 0; j < NR; j++)
+                c[i * ldc + j] += acc[i][j];
+    } else {
+        for (size_t i = 0; i < m; i++)
+            for (size_t j = 0; j < n; j++)
+                c[i * ldc + j] += acc[i][j];
+    }
+}
+
+template <class T>
+GemmKernel<T> genericGemmKernel() {
+    const size_t NR = 64 / sizeof(T) < 4 ? 4 : 64 / sizeof(T);
+    GemmKernel<T> k = {4, NR, &gemmMicroKernel<T, 4, NR>};
+    return k;
+}
+
+// matrices in each pack of a MatrixBatch: a cache line of one element each
+template <class T>
+constexpr size_t batchLanes() {
+    return 64 / sizeof(T) < 1 ? 1 : 64 / sizeof(T);
+}
+
+/**
+ * c = a * b for all the matrices of one pack of a MatrixBatch, m x k
+ * times k x n: element (i, j) of every matrix of the pack lies in the
+ * batchLanes() slots at (i * cols + j) * batchLanes().
+ */
+template <class T>
+void batchGemmPack(size_t m,
+                   size_t n,
+                   size_t k,
+                   const T* a,
+                   const T* b,
+                   T* c) {
+    constexpr size_t L = batchLanes<T>();
+    for (size_t i = 0; i < m; i++)
+        for (size_t j = 0; j < n; j++) {
+            T acc[L];
+            for (size_t l = 0; l < L; l++)
+                acc[l] = T();
+            for (size_t p = 0; p < k; p++) {
+                const T* ap = a + (i * k + p) * L;
+                const T* bp = b + (p * n + j) * L;
+                for (size_t l = 0; l < L; l++)
+                    acc[l] += ap[l] * bp[l];
+            }
+            std::copy(acc, acc + L, c + (i * n + j) * L);
+        }
+}
+
+/**
+ * How the modular GEMM keeps its 64-bit accumulators from overflowing.
+ * Residues are below mod < 2^31, and every lazy products the accumulator
+ * x is folded to (x >> 32) * r32 + (x & (2^32 - 1)), r32 = 2^32 mod mod,
+ * which keeps its residue and brings it back under 2^32 * mod. Folding is
+ * a multiply and an add, so it vectorizes where a division would not.
+ */
+struct ModReduction {
+    std::uint32_t mod;
+    std::uint64_t r32;
+    size_t lazy;
+
+    explicit ModReduction(std::uint32_t m)
+        : mod(m), r32((std::uint64_t(1) << 32) % m), lazy(~size_t(0)) {
+        const std::uint64_t d = m - 1;
+        if (d > 0)
+            lazy = size_t((~std::uint64_t(0) - (std::uint64_t(m) << 32)) /
+                          (d * d));
+    }
+};
+
+/**
+ * c[0..m)[0..n) = (c + a * b) mod r.mod for a packed mr x kc sliver a and
+ * kc x nr sliver b of residues, reducing the sums only once at the end.
+ */
+struct ModKernel {
+    size_t mr, nr;
+    void (*micro)(size_t kc,
+                  const std::uint32_t* a,
+                  const std::uint32_t* b,
+                  std::uint32_t* c,
+                  size_t ldc,
+                  size_t m,
+                  size_t n,
+                  const ModReduction& r);
+};
+
+template <size_t MR, size_t NR>
+void modMicroKernel(size_t kc,
+                    const std::uint32_t* a,
+                    const std::uint32_t* b,
+                    std::uint32_t* c,
+                    size_t ldc,
+                    size_t m,
+                    size_t n,
+                    const ModReduction& r) {
+    std::uint64_t acc[MR][NR] = {};
+    for (size_t p0 = 0; p0 < kc;) {
+        const size_t steps = min(r.lazy, kc - p0);
+        for (size_t p = 0; p < steps; p++, a += MR, b += NR)
+            for (size_t i = 0; i < MR; i++)
+                for (size_t j = 0; j < NR; j++)
+                    acc[i][j] += std::uint64_t(a[i]) * b[j];
+        for (size_t i = 0; i < MR; i++)
+            for (size_t j = 0; j < NR; j++) {
+                const std::uint64_t x = acc[i][j];
+                acc[i][j] = (x >> 32) * r.r32 + (x & 0xffffffffu);
+            }
+        p0 += steps;
+    }
+    for (size_t i = 0; i < m; i++)
+        for (size_t j = 0; j < n; j++)
+            c[i * ldc + j] =
+                std::uint32_t((acc[i][j] + c[i * ldc + j]) % r.mod);
+}
+
+inline ModKernel genericModKernel() {
+    ModKernel k = {4, 8, &modMicroKernel<4, 8>};
+    return k;
+}
+}  // namespace detail
+
+/**
+ * Hand-written kernels for float, double and int32_t. Every instruction
+ * set gets its own copy of the kernels compiled for that target, and the
+ * copy to run is picked from CPUID at the first call, so one binary runs
+ * on every x86-64 host. Define SJTU_MATRIX_NO_SIMD to compile them out.
+ */
+namespace simd {
+enum Level { NONE = 0, SSE4 = 1, AVX2 = 2, AVX512 = 3 };
+
+template <class T>
+struct Supported {
+    static constexpr bool value = std::is_same<T, float>::value ||
+                                  std::is_same<T, double>::value ||
+                                  std::is_same<T, int32_t>::value;
+};
+}  // namespace simd
+}  // namespace sjtu
+
+#if !defined(SJTU_MATRIX_NO_SIMD) &&                   \
+    (defined(__GNUC__) || defined(__clang__)) &&        \
+    (defined(__x86_64__) || defined(__i386__))
+#define SJTU_MATRIX_X86_SIMD 1
+#include <immintrin.h>
+
+// the same kernels for every instruction set, each expanded inside the
+// Ops<T> of its namespace
+#define SJTU_SIMD_KERNELS                                                    \
+    template <class T>                                                       \
+    void add(T* d, const T* a, const T* b, size_t n) {                       \
+        typedef Ops<T> O;                                                    \
+        size_t i = 0;                                                        \
+        for (; i + O::W <= n; i += O::W)                                     \
+            O::store(d + i, O::add(O::load(a + i), O::load(b + i)));         \
+        for (; i < n; i++)                                                   \
+            d[i] = a[i] + b[i];                                              \
+    }                                                                        \
+    template <class T>                                                       \
+    void sub(T* d, const T* a, const T* b, size_t n) {                       \
+        typedef Ops<T> O;                                                    \
+        size_t i = 0;                                                        \
+        for (; i + O::W <= n; i += O::W)                                     \
+            O::store(d + i, O::sub(O::load(a + i), O::load(b + i)));         \
+        for (; i < n; i++)                                                   \
+            d[i] = a[i] - b[i];                                              \
+    }                                                                        \
+    template <class T>                                                       \
+    void scale(T* d, const T* a, T x, size_t n) {                            \
+        typedef Ops<T> O;                                                    \
+        const typename O::reg vx = O::set1(x);                               \
+        size_t i = 0;                                                        \
+        for (; i + O::W <= n; i += O::W)                                     \
+            O::store(d + i, O::mul(O::load(a + i), vx));                     \
+        for (; i < n; i++)                                                   \
+            d[i] = a[i] * x;                                                 \
+    }                                                                        \
+    template <class T>                                                       \
+    void neg(T* d, const T* a, size_t n) {                                   \
+        typedef Ops<T> O;                                                    \
+        const typename O::reg zero = O::zero();                              \
+        size_t i = 0;                                                        \
+        for (; i + O::W <= n; i += O::W)                                     \
+            O::store(d + i, O::sub(zero, O::load(a + i)));                   \
+        for (; i < n; i++)                                                   \
+            d[i] = -a[i];                                                    \
+    }                                                                        \
+    template <class T, size_t MR, size_t NV>                                 \
+    void gemmMicroKernel(size_t kc, const T* a, const T* b, T* c,            \
+                         size_t ldc, size_t m, size_t n) {                   \
+        typedef Ops<T> O;                                                    \
+        const size_t NR = NV * O::W;                                         \
+        typename O::reg acc[MR][NV], bv[NV];                                 \
+        SJTU_UNROLL for (size_t i = 0; i < MR; i++)                          \
+            SJTU_UNROLL for (size_t v = 0; v < NV; v++)                      \
+                acc[i][v] = O::zero();                                       \
+        for (size_t p = 0; p < kc; p++, a += MR, b += NR) {                  \
+            SJTU_UNROLL for (size_t v = 0; v < NV; v++)                      \
+                bv[v] = O::load(b + v * O::W);                               \
+            SJTU_UNROLL for (size_t i = 0; i < MR; i++) {                    \
+                const typename O::reg ai = O::set1(a[i]);                    \
+                SJTU_UNROLL for (size_t v = 0; v < NV; v++)                  \
+                    acc[i][v] = O::fmadd(ai, bv[v], acc[i][v]);              \
+            }                                                                \
+        }                                                                    \
+        if (m == MR && n == NR) {                                            \
+            SJTU_UNROLL for (size_t i = 0; i < MR; i++)                      \
+                SJTU_UNROLL for (size_t v = 0; v < NV; v++) {                \
+                    T* ci = c + i * ldc + v * O::W;                          \
+                    O::store(ci, O::add(O::load(ci), acc[i][v]));            \
+                }                                                            \
+        } else {                                                             \
+            T tile[MR * NR];                                                 \
+            SJTU_UNROLL for (size_t i = 0; i < MR; i++)                      \
+                SJTU_UNROLL for (size_t v = 0; v < NV; v++)                  \
+                    O::store(tile + i * NR + v * O::W, acc[i][v]);           \
+            for (size_t i = 0; i < m; i++)                                   \
+                for (size_t j = 0; j < n; j++)                               \
+                    c[i * ldc + j] += tile[i * NR + j];                      \
+        }                                                                    \
+    }                                                                        \
+    template <class T>                                                       \
+    detail::GemmKernel<T> gemmKernel() {                                     \
+        detail::GemmKernel<T> k = {                                          \
+            GEMM_MR, GEMM_NV * Ops<T>::W,                                    \
+            &gemmMicroKernel<T, GEMM_MR, GEMM_NV>};                          \
+        return k;                                                            \
+    }                                                                        \
+    template <size_t MR, size_t NV>                                          \
+    void modMicroKernel(size_t kc, const std::uint32_t* a,                   \
+                        const std::uint32_t* b, std::uint32_t* c,            \
+                        size_t ldc, size_t m, size_t n,                      \
+                        const detail::ModReduction& r) {                     \
+        typedef ModOps O;                                                    \
+        const size_t NR = NV * O::W;                                         \
+        const typename O::reg r32 = O::set1(r.r32);                          \
+        typename O::reg acc[MR][NV], bv[NV];                                 \
+        SJTU_UNROLL for (size_t i = 0; i < MR; i++)                          \
+            SJTU_UNROLL for (size_t v = 0; v < NV; v++)                      \
+                acc[i][v] = O::zero();                                       \
+        for (size_t p0 = 0; p0 < kc;) {                                      \
+            const size_t steps = min(r.lazy, kc - p0);                       \
+            for (size_t p = 0; p < steps; p++, a += MR, b += NR) {           \
+                SJTU_UNROLL for (size_t v = 0; v < NV; v++)                  \
+                    bv[v] = O::load32(b + v * O::W);                         \
+                SJTU_UNROLL for (size_t i = 0; i < MR; i++) {                \
+                    const typename O::reg ai = O::set1(a[i]);                \
+                    SJTU_UNROLL for (size_t v = 0; v < NV; v++)              \
+                        acc[i][v] = O::add(acc[i][v], O::mul32(ai, bv[v]));  \
+                }                                                            \
+            }                                                                \
+            SJTU_UNROLL for (size_t i = 0; i < MR; i++)                      \
+                SJTU_UNROLL for (size_t v = 0; v < NV; v++)                  \
+                    acc[i][v] = O::fold(acc[i][v], r32);                     \
+            p0 += steps;                                                     \
+        }                                                                    \
+        std::uint64_t tile[MR * NR];                                         \
+        SJTU_UNROLL for (size_t i = 0; i < MR; i++)                          \
+            SJTU_UNROLL for (size_t v = 0; v < NV; v++)                      \
+                O::store(tile + i * NR + v * O::W, acc[i][v]);               \
+        for (size_t i = 0; i < m; i++)                                       \
+            for (size_t j = 0; j < n; j++)                                   \
+                c[i * ldc + j] = std::uint32_t(                              \
+                    (tile[i * NR + j] + c[i * ldc + j]) % r.mod);            \
+    }                                                                        \
+    inline detail::ModKernel modKernel() {                                   \
+        detail::ModKernel k = {MOD_MR, MOD_NV * ModOps::W,                   \
+                               &modMicroKernel<MOD_MR, MOD_NV>};             \
+        return k;                                                            \
+    }                                                                        \
+    template <class T, size_t NB>                                            \
+    void batchBlock(size_t k, size_t n, const T* a, const T* b, T* c) {      \
+        typedef Ops<T> O;                                                    \
+        constexpr size_t L = detail::batchLanes<T>(), V = L / O::W;          \
+        typename O::reg acc[NB][V];                                          \
+        SJTU_UNROLL for (size_t j = 0; j < NB; j++)                          \
+            SJTU_UNROLL for (size_t v = 0; v < V; v++)                       \
+                acc[j][v] = O::zero();                                       \
+        for (size_t p = 0; p < k; p++, a += L, b += n * L)                   \
+            SJTU_UNROLL for (size_t v = 0; v < V; v++) {                     \
+                const typename O::reg av = O::load(a + v * O::W);            \
+                SJTU_UNROLL for (size_t j = 0; j < NB; j++)                  \
+                    acc[j][v] = O::fmadd(av, O::load(b + j * L + v * O::W),  \
+                                         acc[j][v]);                         \
+            }                                                                \
+        SJTU_UNROLL for (size_t j = 0; j < NB; j++)                          \
+            SJTU_UNROLL for (size_t v = 0; v < V; v++)                       \
+                O::store(c + j * L + v * O::W, acc[j][v]);                   \
+    }                                                                        \
+    template <class T>                                                       \
+    void batchGemm(size_t m, size_t n, size_t k, const T* a, const T* b,     \
+                   T* c) {                                                   \
+        constexpr size_t L = detail::batchLanes<T>();                        \
+        constexpr size_t V = L / Ops<T>::W, NB = V >= 8 ? 1 : 8 / V;         \
+        for (size_t i = 0; i < m; i++) {                                     \
+            const T* ai = a + i * k * L;                                     \
+            T* ci = c + i * n * L;                                           \
+            size_t j = 0;                                                    \
+            for (; j + NB <= n; j += NB)                                     \
+                batchBlock<T, NB>(k, n, ai, b + j * L, ci + j * L);          \
+            for (; j < n; j++)                                               \
+                batchBlock<T, 1>(k, n, ai, b + j * L, ci + j * L);           \
+        }                                                                    \
+    }
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("sse4.1"))), \
+                             apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+#endif
+namespace sjtu {
+namespace simd {
+namespace sse4 {
+const size_t GEMM_MR = 4, GEMM_NV = 2;
+const size_t MOD_MR = 4, MOD_NV = 2;
+
+template <class T>
+struct Ops;
+
+template <>
+struct Ops<float> {
+    typedef __m128 reg;
+    static constexpr size_t W = 4;
+    static reg load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, reg x) { _mm_storeu_ps(p, x); }
+    static reg set1(float x) { return _mm_set1_ps(x); }
+    static reg zero() { return _mm_setzero_ps(); }
+    static reg add(reg x, reg y) { return _mm_add_ps(x, y); }
+    static reg sub(reg x, reg y) { return _mm_sub_ps(x, y); }
+    static reg mul(reg x, reg y) { return _mm_mul_ps(x, y); }
+    static reg fmadd(reg x, reg y, reg z) {
+        return _mm_add_ps(_mm_mul_ps(x, y), z);
+    }
+};
+
+template <>
+struct Ops<double> {
+    typedef __m128d reg;
+    static constexpr size_t W = 2;
+    static reg load(const double* p) { return _mm_loadu_pd(p); }
+    static void store(double* p, reg x) { _mm_storeu_pd(p, x); }
+    static reg set1(double x) { return _mm_set1_pd(x); }
+    static reg zero() { return _mm_setzero_pd(); }
+    static reg add(reg x, reg y) { return _mm_add_pd(x, y); }
+    static reg sub(reg x, reg y) { return _mm_sub_pd(x, y); }
+    static reg mul(reg x, reg y) { return _mm_mul_pd(x, y); }
+    static reg fmadd(reg x, reg y, reg z) {
+        return _mm_add_pd(_mm_mul_pd(x, y), z);
+    }
+};
+
+template <>
+struct Ops<int32_t> {
+    typedef __m128i reg;
+    static constexpr size_t W = 4;
+    static reg load(const int32_t* p) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    }
+    static void store(int32_t* p, reg x) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+    }
+    static reg set1(int32_t x) { return _mm_set1_epi32(x); }
+    static reg zero() { return _mm_setzero_si128(); }
+    static reg add(reg x, reg y) { return _mm_add_epi32(x, y); }
+    static reg sub(reg x, reg y) { return _mm_sub_epi32(x, y); }
+    static reg mul(reg x, reg y) { return _mm_mullo_epi32(x, y); }
+    static reg fmadd(reg x, reg y, reg z) {
+        return _mm_add_epi32(_mm_mullo_epi32(x, y), z);
+    }
+};
+
+// 64-bit lanes for the modular GEMM, fed from 32-bit residues
+struct ModOps {
+    typedef __m128i reg;
+    static constexpr size_t W = 2;
+    static reg load32(const std::uint32_t* p) {
+        return _mm_cvtepu32_epi64(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+    static void store(std::uint64_t* p, reg x) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+    }
+    static reg set1(std::uint64_t x) { return _mm_set1_epi64x((long long)x); }
+    static reg zero() { return _mm_setzero_si128(); }
+    static reg add(reg x, reg y) { return _mm_add_epi64(x, y); }
+    static reg mul32(reg x, reg y) { return _mm_mul_epu32(x, y); }
+    static reg fold(reg x, reg r32) {
+        return _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), r32),
+                             _mm_and_si128(x, _mm_set1_epi64x(0xffffffff)));
+    }
+};
+
+SJTU_SIMD_KERNELS
+
+// d = s^T for one 4 x 4 tile of floats, or 2 x 2 tile of doubles
+inline void transposeTile(const float* s, size_t lds, float* d, size_t ldd) {
+    __m128 r0 = _mm_loadu_ps(s), r1 = _mm_loadu_ps(s + lds);
+    __m128 r2 = _mm_loadu_ps(s + 2 * lds), r3 = _mm_loadu_ps(s + 3 * lds);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    _mm_storeu_ps(d, r0);
+    _mm_storeu_ps(d + ldd, r1);
+    _mm_storeu_ps(d + 2 * ldd, r2);
+    _mm_storeu_ps(d + 3 * ldd, r3);
+}
+
+inline void transposeTile(const double* s,
+                          size_t lds,
+                          double* d,
+                          size_t ldd) {
+    const __m128d r0 = _mm_loadu_pd(s), r1 = _mm_loadu_pd(s + lds);
+    _mm_storeu_pd(d, _mm_unpacklo_pd(r0, r1));
+    _mm_storeu_pd(d + ldd, _mm_unpackhi_pd(r0, r1));
+}
+}  // namespace sse4
+}  // namespace simd
+}  // namespace sjtu
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), \
+                             apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+namespace sjtu {
+namespace simd {
+namespace avx2 {
+const size_t GEMM_MR = 6, GEMM_NV = 2;
+const size_t MOD_MR = 4, MOD_NV = 2;
+
+template <class T>
+struct Ops;
+
+template <>
+struct Ops<float> {
+    typedef __m256 reg;
+    static constexpr size_t W = 8;
+    static reg load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, reg x) { _mm256_storeu_ps(p, x); }
+    static reg set1(float x) { return _mm256_set1_ps(x); }
+    static reg zero() { return _mm256_setzero_ps(); }
+    static reg add(reg x, reg y) { return _mm256_add_ps(x, y); }
+    static reg sub(reg x, reg y) { return _mm256_sub_ps(x, y); }
+    static reg mul(reg x, reg y) { return _mm256_mul_ps(x, y); }
+    static reg fmadd(reg x, reg y, reg z) { return _mm256_fmadd_ps(x, y, z); }
+};
+
+template <>
+struct Ops<double> {
+    typedef __m256d reg;
+    static constexpr size_t W = 4;
+    static reg load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, reg x) { _mm256_storeu_pd(p, x); }
+    static reg set1(double x) { return _mm256_set1_pd(x); }
+    static reg zero() { return _mm256_setzero_pd(); }
+    static reg add(reg x, reg y) { return _mm256_add_pd(x, y); }
+    static reg sub(reg x, reg y) { return _mm256_sub_pd(x, y); }
+    static reg mul(reg x, reg y) { return _mm256_mul_pd(x, y); }
+    static reg fmadd(reg x, reg y, reg z) { return _mm256_fmadd_pd(x, y, z); }
+};
+
+template <>
+struct Ops<int32_t> {
+    typedef __m256i reg;
+    static constexpr size_t W = 8;
+    static reg load(const int32_t* p) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    }
+    static void store(int32_t* p, reg x) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);
+    }
+    static reg set1(int32_t x) { return _mm256_set1_epi32(x); }
+    static reg zero() { return _mm256_setzero_si256(); }
+    static reg add(reg x, reg y) { return _mm256_add_epi32(x, y); }
+    static reg sub(reg x, reg y) { return _mm256_sub_epi32(x, y); }
+    static reg mul(reg x, reg y) { return _mm256_mullo_epi32(x, y); }
+    static reg fmadd(reg x, reg y, reg z) {
+        return _mm256_add_epi32(_mm256_mullo_epi32(x, y), z);
+    }
+};
+
+struct ModOps {
+    typedef __m256i reg;
+    static constexpr size_t W = 4;
+    static reg load32(const std::uint32_t* p) {
+        return _mm256_cvtepu32_epi64(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    static void store(std::uint64_t* p, reg x) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);
+    }
+    static reg set1(std::uint64_t x) {
+        return _mm256_set1_epi64x((long long)x);
+    }
+    static reg zero() { return _mm256_setzero_si256(); }
+    static reg add(reg x, reg y) { return _mm256_add_epi64(x, y); }
+    static reg mul32(reg x, reg y) { return _mm256_mul_epu32(x, y); }
+    static reg fold(reg x, reg r32) {
+        return _mm256_add_epi64(
+            _mm256_mul_epu32(_mm256_srli_epi64(x, 32), r32),
+            _mm256_and_si256(x, _mm256_set1_epi64x(0xffffffff)));
+    }
+};
+
+SJTU_SIMD_KERNELS
+
+// d = s^T for one 8 x 8 tile of floats, or 4 x 4 tile of doubles
+inline void transposeTile(const float* s, size_t lds, float* d, size_t ldd) {
+    __m256 r[8], t[8];
+    for (size_t i = 0; i < 8; i++)
+        r[i] = _mm256_loadu_ps(s + i * lds);
+    for (size_t i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_ps(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_ps(r[i], r[i + 1]);
+    }
+    for (size_t i = 0; i < 8; i += 4) {
+        r[i] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(1, 0, 1, 0));
+        r[i + 1] = _mm256_shuffle_ps(t[i], t[i + 2], _MM_SHUFFLE(3, 2, 3, 2));
+        r[i + 2] =
+            _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(1, 0, 1, 0));
+        r[i + 3] =
+            _mm256_shuffle_ps(t[i + 1], t[i + 3], _MM_SHUFFLE(3, 2, 3, 2));
+    }
+    for (size_t i = 0; i < 4; i++) {
+        _mm256_storeu_ps(d + i * ldd,
+                         _mm256_permute2f128_ps(r[i], r[i + 4], 0x20));
+        _mm256_storeu_ps(d + (i + 4) * ldd,
+                         _mm256_permute2f128_ps(r[i], r[i + 4], 0x31));
+    }
+}
+
+inline void transposeTile(const double* s,
+                          size_t lds,
+                          double* d,
+                          size_t ldd) {
+    const __m256d r0 = _mm256_loadu_pd(s), r1 = _mm256_loadu_pd(s + lds);
+    const __m256d r2 = _mm256_loadu_pd(s + 2 * lds);
+    const __m256d r3 = _mm256_loadu_pd(s + 3 * lds);
+    const __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+    const __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+    const __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+    const __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+    _mm256_storeu_pd(d, _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_storeu_pd(d + ldd, _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_storeu_pd(d + 2 * ldd, _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_storeu_pd(d + 3 * ldd, _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+}  // namespace avx2
+}  // namespace simd
+}  // namespace sjtu
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f"))), \
+                             apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#endif
+namespace sjtu {
+namespace simd {
+namespace avx512 {
+const size_t GEMM_MR = 12, GEMM_NV = 2;
+const size_t MOD_MR = 8, MOD_NV = 2;
+
+template <class T>
+struct Ops;
+
+template <>
+struct Ops<float> {
+    typedef __m512 reg;
+    static constexpr size_t W = 16;
+    static reg load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, reg x) { _mm512_storeu_ps(p, x); }
+    static reg set1(float x) { return _mm512_set1_ps(x); }
+    static reg zero() { return _mm512_setzero_ps(); }
+    static reg add(reg x, reg y) { return _mm512_add_ps(x, y); }
+    static reg sub(reg x, reg y) { return _mm512_sub_ps(x, y); }
+    static reg mul(reg x, reg y) { return _mm512_mul_ps(x, y); }
+    static reg fmadd(reg x, reg y, reg z) { return _mm512_fmadd_ps(x, y, z); }
+};
+
+template <>
+struct Ops<double> {
+    typedef __m512d reg;
+    static constexpr size_t W = 8;
+    static reg load(const double* p) { return _mm512_loadu_pd(p); }
+    static void store(double* p, reg x) { _mm512_storeu_pd(p, x); }
+    static reg set1(double x) { return _mm512_set1_pd(x); }
+    static reg zero() { return _mm512_setzero_pd(); }
+    static reg add(reg x, reg y) { return _mm512_add_pd(x, y); }
+    static reg sub(reg x, reg y) { return _mm512_sub_pd(x, y); }
+    static reg mul(reg x, reg y) { return _mm512_mul_pd(x, y); }
+    static reg fmadd(reg x, reg y, reg z) { return _mm512_fmadd_pd(x, y, z); }
+};
+
+template <>
+struct Ops<int32_t> {
+    typedef __m512i reg;
+    static constexpr size_t W = 16;
+    static reg load(const int32_t* p) { return _mm512_loadu_si512(p); }
+    static void store(int32_t* p, reg x) { _mm512_storeu_si512(p, x); }
+    static reg set1(int32_t x) { return _mm512_set1_epi32(x); }
+    static reg zero() { return _mm512_setzero_si512(); }
+    static reg add(reg x, reg y) { return _mm512_add_epi32(x, y); }
+    static reg sub(reg x, reg y) { return _mm512_sub_epi32(x, y); }
+    static reg mul(reg x, reg y) { return _mm512_mullo_epi32(x, y); }
+    static reg fmadd(reg x, reg y, reg z) {
+        return _mm512_add_epi32(_mm512_mullo_epi32(x, y), z);
+    }
+};
+
+// the zero-masked forms under a full mask: the plain ones start from
+// _mm512_undefined_epi32(), which GCC warns may be used uninitialized
+struct ModOps {
+    typedef __m512i reg;
+    static constexpr size_t W = 8;
+    static constexpr __mmask8 ALL = 0xff;
+    static reg load32(const std::uint32_t* p) {
+        return _mm512_maskz_cvtepu32_epi64(
+            ALL, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+    }
+    static void store(std::uint64_t* p, reg x) { _mm512_storeu_si512(p, x); }
+    static reg set1(std::uint64_t x) { return _mm512_set1_epi64((long long)x); }
+    static reg zero() { return _mm512_setzero_si512(); }
+    static reg add(reg x, reg y) { return _mm512_add_epi64(x, y); }
+    static reg mul32(reg x, reg y) { return _mm512_maskz_mul_epu32(ALL, x, y); }
+    static reg fold(reg x, reg r32) {
+        return _mm512_add_epi64(
+            _mm512_maskz_mul_epu32(ALL, _mm512_maskz_srli_epi64(ALL, x, 32),
+                                   r32),
+            _mm512_and_si512(x, _mm512_set1_epi64(0xffffffff)));
+    }
+};
+
+SJTU_SIMD_KERNELS
+}  // namespace avx512
+}  // namespace simd
+}  // namespace sjtu
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#undef SJTU_SIMD_KERNELS
+#endif  // SJTU_MATRIX_X86_SIMD
+
+namespace sjtu {
+namespace simd {
+// the best instruction set the running CPU supports
+inline Level detected() {
+#ifdef SJTU_MATRIX_X86_SIMD
+    static const Level lv = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return AVX512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            return AVX2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return SSE4;
+        return NONE;
+    }();
+    return lv;
+#else
+    return NONE;
+#endif
+}
+
+inline Level& currentLevel() {
+    static Level lv = detected();
+    return lv;
+}
+
+// the instruction set the kernels dispatch to
+inline Level level() {
+    return currentLevel();
+}
+
+// restricts dispatch to at most lv, e.g. to compare kernels
+inline void setLevel(Level lv) {
+    currentLevel() = min(lv, detected());
+}
+
+#ifdef SJTU_MATRIX_X86_SIMD
+#define SJTU_SIMD_DISPATCH(call)        \
+    switch (level()) {                  \
+        case AVX512:                    \
+            return avx512::call;        \
+        case AVX2:                      \
+            return avx2::call;          \
+        case SSE4:                      \
+            return sse4::call;          \
+        default:                        \
+            break;                      \
+    }
+#else
+#define SJTU_SIMD_DISPATCH(call)
+#endif
+
+template <class T>
+void add(T* d, const T* a, const T* b, size_t n) {
+    SJTU_SIMD_DISPATCH(add(d, a, b, n));
+    for (size_t i = 0; i < n; i++)
+        d[i] = a[i] + b[i];
+}
+
+template <class T>
+void sub(T* d, const T* a, const T* b, size_t n) {
+    SJTU_SIMD_DISPATCH(sub(d, a, b, n));
+    for (size_t i = 0; i < n; i++)
+        d[i] = a[i] - b[i];
+}
+
+template <class T>
+void scale(T* d, const T* a, T x, size_t n) {
+    SJTU_SIMD_DISPATCH(scale(d, a, x, n));
+    for (size_t i = 0; i < n; i++)
+        d[i] = a[i] * x;
+}
+
+template <class T>
+void neg(T* d, const T* a, size_t n) {
+    SJTU_SIMD_DISPATCH(neg(d, a, n));
+    for (size_t i = 0; i < n; i++)
+        d[i] = -a[i];
+}
+
+template <class T>
+detail::GemmKernel<T> gemmKernel() {
+    SJTU_SIMD_DISPATCH(gemmKernel<T>());
+    return detail::genericGemmKernel<T>();
+}
+
+inline detail::ModKernel modKernel() {
+    SJTU_SIMD_DISPATCH(modKernel());
+    return detail::genericModKernel();
+}
+
+template <class T>
+void batchGemm(size_t m, size_t n, size_t k, const T* a, const T* b, T* c) {
+    if constexpr (Supported<T>::value) {
+        SJTU_SIMD_DISPATCH(batchGemm(m, n, k, a, b, c));
+    }
+    detail::batchGemmPack(m, n, k, a, b, c);
+}
+
+#undef SJTU_SIMD_DISPATCH
+
+/**
+ * An in-register transpose of a w x w tile, for 4 and 8 byte elements;
+ * fn is NULL when there is none.
+ */
+template <class T>
+struct TransposeKernel {
+    size_t w;
+    void (*fn)(const T* s, size_t lds, T* d, size_t ldd);
+};
+
+template <class T>
+TransposeKernel<T> transposeKernel() {
+    TransposeKernel<T> k = {1, NULL};
+#ifdef SJTU_MATRIX_X86_SIMD
+    if constexpr (std::is_same<T, float>::value ||
+                  std::is_same<T, double>::value) {
+        const size_t lanes = 16 / sizeof(T);
+        if (level() >= AVX2) {
+            k.w = 2 * lanes;
+            k.fn = &avx2::transposeTile;
+        } else if (level() >= SSE4) {
+            k.w = lanes;
+            k.fn = &sse4::transposeTile;
+        }
+    }
+#endif
+    return k;
+}
+}  // namespace simd
+
+namespace detail {
+/**
+ * runs f(begin, end) over [0, n), spread over the pool for big arrays of
+ * arithmetic types; user types may not be safe to touch concurrently
+ */
+template <class T, class F>
+void elementwise(size_t n, const F& f) {
+    if (std::is_arithmetic<T>::value && n >= 2 * ELEMENTWISE_GRAIN) {
+        parallelChunks(n, ELEMENTWISE_GRAIN, f);
+    } else {
+        f(size_t(0), n);
+    }
+}
+
+// d = a + b elementwise, vectorized when no conversion is involved
+template <class T, class U, class V>
+void addArrays(T* d, const U* a, const V* b, size_t n) {
+    elementwise<T>(n, [=](size_t l, size_t r) {
+        if constexpr (std::is_same<T, U>::value &&
+                      std::is_same<T, V>::value && simd::Supported<T>::value) {
+            simd::add(d + l, a + l, b + l, r - l);
+        } else {
+            for (size_t i = l; i < r; i++)
+                d[i] = T(a[i] + b[i]);
+        }
+    });
+}
+
+template <class T, class U, class V>
+void subArrays(T* d, const U* a, const V* b, size_t n) {
+    elementwise<T>(n, [=](size_t l, size_t r) {
+        if constexpr (std::is_same<T, U>::value &&
+                      std::is_same<T, V>::value && simd::Supported<T>::value) {
+            simd::sub(d + l, a + l, b + l, r - l);
+        } else {
+            for (size_t i = l; i < r; i++)
+                d[i] = T(a[i] - b[i]);
+        }
+    });
+}
+
+// d = a * x elementwise; T(a * x) == a * T(x) whenever a * x is a T
+template <class T, class U>
+void scaleArray(T* d, const T* a, const U& x, size_t n) {
+    elementwise<T>(n, [=, &x](size_t l, size_t r) {
+        if constexpr (std::is_same<decltype(T() * U()), T>::value &&
+                      simd::Supported<T>::value) {
+            simd::scale(d + l, a + l, T(x), r - l);
+        } else {
+            for (size_t i = l; i < r; i++)
+                d[i] = T(a[i] * x);
+        }
+    });
+}
+
+template <class T>
+void negArray(T* d, const T* a, size_t n) {
+    elementwise<T>(n, [=](size_t l, size_t r) {
+        if constexpr (simd::Supported<T>::value) {
+            simd::neg(d + l, a + l, r - l);
+        } else {
+            for (size_t i = l; i < r; i++)
+                d[i] = -a[i];
+        }
+    });
+}
+
+// the same-sized float or double whose tile kernels can move T around
+template <class T>
+using TransposeCarrier = typename std::conditional<
+    std::is_arithmetic<T>::value && sizeof(T) == sizeof(float),
+    float,
+    typename std::conditional<std::is_arithmetic<T>::value &&
+                                  sizeof(T) == sizeof(double),
+                              double,
+                              T>::type>::type;
+
+// transposes tiles of T as tiles of its carrier, bit for bit
+template <class T>
+struct TileTransposer {
+    typedef TransposeCarrier<T> X;
+    simd::TransposeKernel<X> kern;
+
+    TileTransposer() : kern(simd::transposeKernel<X>()) {}
+
+    size_t width() const { return kern.fn ? kern.w : 1; }
+
+    void operator()(const T* s, size_t lds, T* d, size_t ldd) const {
+        if (kern.fn) {
+            kern.fn(reinterpret_cast<const X*>(s), lds,
+                    reinterpret_cast<X*>(d), ldd);
+        } else {
+            *d = *s;
+        }
+    }
+};
+
+const size_t TRANSPOSE_BLOCK = 64;
+
+/**
+ * dst = src^T for an r x c src with row strides lds and ldd, in square
+ * blocks that keep both sides in cache and the TLB, each made of
+ * in-register tiles. Block rows are spread over the pool.
+ */
+template <class T>
+void transpose(const T* src, size_t r, size_t c, size_t lds, T* dst,
+               size_t ldd) {
+    const size_t B = TRANSPOSE_BLOCK;
+    const TileTransposer<T> tile;
+    const size_t w = tile.width();
+    auto blockRow = [&](size_t bi) {
+        const size_t i0 = bi * B, i1 = min(r, i0 + B);
+        for (size_t j0 = 0; j0 < c; j0 += B) {
+            const size_t j1 = min(c, j0 + B);
+            size_t i = i0;
+            for (; i + w <= i1; i += w) {
+                size_t j = j0;
+                for (; j + w <= j1; j += w)
+                    tile(src + i * lds + j, lds, dst + j * ldd + i, ldd);
+                for (size_t ii = i; ii < i + w; ii++)
+                    for (size_t jj = j; jj < j1; jj++)
+                        dst[jj * ldd + ii] = src[ii * lds + jj];
+            }
+            for (; i < i1; i++)
+                for (size_t j = j0; j < j1; j++)
+                    dst[j * ldd + i] = src[i * lds + j];
+        }
+    };
+    const size_t blocks = (r + B - 1) / B;
+    if (std::is_arithmetic<T>::value && r * c >= 2 * ELEMENTWISE_GRAIN) {
+        ThreadPool::global().parallelFor(blocks, blockRow);
+    } else {
+        for (size_t bi = 0; bi < blocks; bi++)
+            blockRow(bi);
+    }
+}
+
+/**
+ * a = a^T for an n x n a with row stride ld. Tile (i, j) is swapped with
+ * tile (j, i) through a small buffer, one block row of tile pairs per
+ * task.
+ */
+template <class T>
+void transposeSquareTiles(T* a, size_t n, size_t ld) {
+    const size_t B = TRANSPOSE_BLOCK;
+    const TileTransposer<T> tile;
+    const size_t w = tile.width();
+    const size_t full = n / w * w;
+    auto blockRow = [&](size_t bi) {
+        T buf[8 * 8], back[8 * 8];
+        const size_t i0 = bi * B, i1 = min(full, i0 + B);
+        for (size_t j0 = i0; j0 < full; j0 += B) {
+            const size_t j1 = min(full, j0 + B);
+            for (size_t i = i0; i < i1; i += w)
+                for (size_t j = max(j0, i); j < j1; j += w) {
+                    T* x = a + i * ld + j;
+                    T* y = a + j * ld + i;
+                    if (w == 1) {
+                        swap(*x, *y);
+                        continue;
+                    }
+                    tile(x, ld, buf, w);
+                    if (x != y) {
+                        tile(y, ld, back, w);
+                        for (size_t k = 0; k < w; k++)
+                            std::copy(back + k * w, back + (k + 1) * w,
+                                      x + k * ld);
+                    }
+                    for (size_t k = 0; k < w; k++)
+                        std::copy(buf + k * w, buf + (k + 1) * w, y + k * ld);
+                }
+        }
+        // the ragged last columns pair up with the ragged last rows
+        for (size_t i = i0; i < i1; i++)
+            for (size_t j = full; j < n; j++)
+                swap(a[i * ld + j], a[j * ld + i]);
+    };
+    const size_t blocks = (full + B - 1) / B;
+    if (std::is_arithmetic<T>::value && n * n >= 2 * ELEMENTWISE_GRAIN) {
+        ThreadPool::global().parallelFor(blocks, blockRow);
+    } else {
+        for (size_t bi = 0; bi < blocks; bi++)
+            blockRow(bi);
+    }
+    for (size_t i = full; i < n; i++)
+        for (size_t j = i + 1; j < n; j++)
+            swap(a[i * ld + j], a[j * ld + i]);
+}
+
+// transposeSquareTiles() for T whose tile buffers cost nothing to set
+// up, plain swaps for the rest
+template <class T>
+void transposeSquareInPlace(T* a, size_t n, size_t ld) {
+    if constexpr (std::is_trivial<T>::value) {
+        transposeSquareTiles(a, n, ld);
+    } else {
+        for (size_t i = 0; i < n; i++)
+            for (size_t j = i + 1; j < n; j++)
+                swap(a[i * ld + j], a[j * ld + i]);
+    }
+}
+
+// x * y mod m without overflow
+inline size_t mulMod(size_t x, size_t y, size_t m) {
+#ifdef __SIZEOF_INT128__
+    return size_t((unsigned __int128)x * y % m);
+#else
+    size_t r = 0;
+    x %= m;
+    for (; y; y >>= 1) {
+        if (y & 1)
+            r = r >= m - x ? r - (m - x) : r + x;
+        x = x >= m - x ? x - (m - x) : x + x;
+    }
+    return r;
+#endif
+}
+
+/**
+ * a = a^T for a contiguous r x c a, by following the cycles of the
+ * permutation k -> k * r mod (r * c - 1). Needs one bit of scratch per
+ * element instead of a second matrix.
+ */
+template <class T>
+void transposeCyclesInPlace(T* a, size_t r, size_t c) {
+    const size_t n = r * c;
+    if (r <= 1 || c <= 1)
+        return;
+    std::vector<bool> done(n, false);
+    for (size_t start = 1; start + 1 < n; start++) {
+        if (done[start])
+            continue;
+        T carry = a[start];
+        size_t k = start;
+        do {
+            k = mulMod(k, r, n - 1);
+            swap(carry, a[k]);
+            done[k] = true;
+        } while (k != start);
+    }
+}
+
+template <class T>
+GemmKernel<T> gemmKernel() {
+    if constexpr (simd::Supported<T>::value) {
+        return simd::gemmKernel<T>();
+    } else {
+        return genericGemmKernel<T>();
+    }
+}
+
+// packs an mc x kc block of a into mr-row slivers, zero padding the tail
+template <class T, class U>
+void packA(size_t mc,
+           size_t kc,
+           const U* a,
+           size_t rs,
+           size_t cs,
+           size_t mr,
+           T* buf) {
+    for (size_t i = 0; i < mc; i += mr) {
+        const size_t m = min(mr, mc - i);
+        for (size_t p = 0; p < kc; p++) {
+            const U* src = a + i * rs + p * cs;
+            size_t r = 0;
+            for (; r < m; r++)
+                *buf++ = T(src[r * rs]);
+            for (; r < mr; r++)
+                *buf++ = T(0);
+        }
+    }
+}
+
+// packs a kc x nc block of b into nr-column slivers, zero padding the tail
+template <class T, class U>
+void packB(size_t kc,
+           size_t nc,
+           const U* b,
+           size_t rs,
+           size_t cs,
+           size_t nr,
+           T* buf) {
+    for (size_t j = 0; j < nc; j += nr) {
+        const size_t n = min(nr, nc - j);
+        for (size_t p = 0; p < kc; p++) {
+            const U* src = b + p * rs + j * cs;
+            size_t c = 0;
+            for (; c < n; c++)
+                *buf++ = T(src[c * cs]);
+            for (; c < nr; c++)
+                *buf++ = T(0);
+        }
+    }
+}
+
+// per-thread buffers, kept across calls: 0 and 1 for packing, 2 for
+// scratch that is held across a parallelFor() (see BorrowedWorkspace)
+template <class T>
+Vector<T>& workspaceSlot(size_t which) {
+    thread_local Vector<T> buf[3];
+    return buf[which];
+}
+
+// per-thread packing buffers, kept across calls
+template <class T>
+T* gemmWorkspace(size_t which, size_t n) {
+    Vector<T>& buf = workspaceSlot<T>(which);
+    if (buf.size() < n)
+        buf = Vector<T>(n);
+    return buf.data();
+}
+
+/**
+ * At least n elements of a per-thread scratch slot, taken out of it until
+ * destruction. A thread waiting in parallelFor() runs other tasks, and a
+ * product among them then finds the slot empty and brings its own buffer
+ * instead of growing this one under our feet.
+ */
+template <class T>
+class BorrowedWorkspace {
+   private:
+    Vector<T>& slot;
+    Vector<T> buf;
+
+   public:
+    BorrowedWorkspace(size_t which, size_t n)
+        : slot(workspaceSlot<T>(which)), buf(std::move(slot)) {
+        if (buf.size() < n)
+            buf = Vector<T>(n);
+    }
+
+    BorrowedWorkspace(const BorrowedWorkspace&) = delete;
+    BorrowedWorkspace& operator=(const BorrowedWorkspace&) = delete;
+
+    ~BorrowedWorkspace() { slot = std::move(buf); }
+
+    T* data() { return buf.data(); }
+};
+
+/**
+ * c += a * b for an M x K matrix a and a K x N matrix b given by element
+ * strides (rs, cs); c is row major with leading dimension ldc.
+ */
+template <class T, class U, class V>
+void gemm(size_t M,
+          size_t N,
+          size_t K,
+          const U* a,
+          size_t rsa,
+          size_t csa,
+          const V* b,
+          size_t rsb,
+          size_t csb,
+          T* c,
+          size_t ldc) {
+    typedef GemmBlocking<T> BL;
+    if (M == 0 || N == 0 || K == 0)
+        return;
+    const GemmKernel<T> kern = gemmKernel<T>();
+    const size_t MR = kern.mr, NR = kern.nr;
+    const size_t MC = BL::MC / MR * MR, NC = BL::NC / NR * NR;
+    const size_t kcMax = min(BL::KC, K);
+    const size_t mcMax = min(MC, (M + MR - 1) / MR * MR);
+    const size_t ncMax = min(NC, (N + NR - 1) / NR * NR);
+    T* bufA = gemmWorkspace<T>(0, mcMax * kcMax);
+    T* bufB = gemmWorkspace<T>(1, kcMax * ncMax);
+    for (size_t jc = 0; jc < N; jc += NC) {
+        const size_t nc = min(NC, N - jc);
+        for (size_t pc = 0; pc < K; pc += BL::KC) {
+            const size_t kc = min(BL::KC, K - pc);
+            packB(kc, nc, b + pc * rsb + jc * csb, rsb, csb, NR, bufB);
+            for (size_t ic = 0; ic < M; ic += MC) {
+                const size_t mc = min(MC, M - ic);
+                packA(mc, kc, a + ic * rsa + pc * csa, rsa, csa, MR, bufA);
+                for (size_t jr = 0; jr < nc; jr += NR) {
+                    const size_t n = min(NR, nc - jr);
+                    for (size_t ir = 0; ir < mc; ir += MR) {
+                        kern.micro(kc, bufA + ir * kc, bufB + jr * kc,
+                                   c + (ic + ir) * ldc + jc + jr, ldc,
+                                   min(MR, mc - ir), n);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// below this many multiply-adds a product is not worth splitting
+const size_t GEMM_PARALLEL_WORK = size_t(128) * 128 * 128;
+
+/**
+ * gemm() with c cut into a grid of 2D tiles, each an independent task for
+ * the pool. Tiles are shrunk until there are a few per thread so that work
+ * stealing can even out the load.
+ */
+template <class T, class U, class V>
+void gemmParallel(size_t M,
+                  size_t N,
+                  size_t K,
+                  const U* a,
+                  size_t rsa,
+                  size_t csa,
+                  const V* b,
+                  size_t rsb,
+                  size_t csb,
+                  T* c,
+                  size_t ldc) {
+    ThreadPool& pool = ThreadPool::global();
+    if (pool.size() == 1 || M * N * K < GEMM_PARALLEL_WORK) {
+        gemm(M, N, K, a, rsa, csa, b, rsb, csb, c, ldc);
+        return;
+    }
+    const GemmKernel<T> kern = gemmKernel<T>();
+    size_t tm = GemmBlocking<T>::MC / kern.mr * kern.mr;
+    size_t tn = 4 * GemmBlocking<T>::KC / kern.nr * kern.nr;
+    auto tiles = [&] { return ((M + tm - 1) / tm) * ((N + tn - 1) / tn); };
+    while (tiles() < 4 * pool.size()) {
+        if (tn >= 2 * tm && tn / 2 >= 2 * kern.nr)
+            tn = tn / 2 / kern.nr * kern.nr;
+        else if (tm / 2 >= 2 * kern.mr)
+            tm = tm / 2 / kern.mr * kern.mr;
+        else
+            break;
+    }
+    const size_t tilesN = (N + tn - 1) / tn;
+    pool.parallelFor(tiles(), [&](size_t t) {
+        const size_t i0 = t / tilesN * tm, j0 = t % tilesN * tn;
+        gemm(min(tm, M - i0), min(tn, N - j0), K, a + i0 * rsa, rsa, csa,
+             b + j0 * csb, rsb, csb, c + i0 * ldc + j0, ldc);
+    });
+}
+
+// plain i-k-j product for small inputs and non-arithmetic element types
+template <class T, class U, class V>
+void gemmNaive(size_t M,
+               size_t N,
+               size_t K,
+               const U* a,
+               size_t rsa,
+               size_t csa,
+               const V* b,
+               size_t rsb,
+               size_t csb,
+               T* c,
+               size_t rsc,
+               size_t csc) {
+    for (size_t i = 0; i < M; i++)
+        for (size_t k = 0; k < K; k++) {
+            const U& aik = a[i * rsa + k * csa];
+            const V* bk = b + k * rsb;
+            T* ci = c + i * rsc;
+            for (size_t j = 0; j < N; j++)
+                ci[j * csc] += aik * bk[j * csb];
+        }
+}
+
+/**
+ * c = (c + a * b) mod mod for residues below mod < 2^31, c row major; a
+ * and b are given by element strides as in gemm() and packed as 32-bit
+ * residues. Each micro-kernel call covers all of K so that every element
+ * is reduced just once, and the blocks are sized from K instead to keep
+ * packed A in L2 and packed B in L3.
+ */
+template <class U, class V>
+void modGemm(size_t M,
+             size_t N,
+             size_t K,
+             const U* a,
+             size_t rsa,
+             size_t csa,
+             const V* b,
+             size_t rsb,
+             size_t csb,
+             std::uint32_t* c,
+             size_t ldc,
+             std::uint32_t mod) {
+    if (M == 0 || N == 0 || K == 0)
+        return;
+    const ModKernel kern = simd::modKernel();
+    const ModReduction red(mod);
+    const size_t MR = kern.mr, NR = kern.nr;
+    const size_t budgetA = size_t(1) << 16, budgetB = size_t(1) << 19;
+    const size_t MC = max(MR, budgetA / K / MR * MR);
+    const size_t NC = max(NR, budgetB / K / NR * NR);
+    const size_t blocks = (M + MC - 1) / MC;
+    // each chunk packs B into the workspace of the thread running it, so
+    // no thread reads a buffer another one may grow; a few chunks per
+    // thread keep the repacking small
+    auto rows = [&](size_t lo, size_t hi) {
+        std::uint32_t* bufA = gemmWorkspace<std::uint32_t>(0, MC * K);
+        std::uint32_t* bufB = gemmWorkspace<std::uint32_t>(
+            1, K * min(NC, (N + NR - 1) / NR * NR));
+        for (size_t jc = 0; jc < N; jc += NC) {
+            const size_t nc = min(NC, N - jc);
+            packB(K, nc, b + jc * csb, rsb, csb, NR, bufB);
+            for (size_t blk = lo; blk < hi; blk++) {
+                const size_t ic = blk * MC, mc = min(MC, M - ic);
+                packA(mc, K, a + ic * rsa, rsa, csa, MR, bufA);
+                for (size_t jr = 0; jr < nc; jr += NR)
+                    for (size_t ir = 0; ir < mc; ir += MR)
+                        kern.micro(K, bufA + ir * K, bufB + jr * K,
+                                   c + (ic + ir) * ldc + jc + jr, ldc,
+                                   min(MR, mc - ir), min(NR, nc - jr), red);
+            }
+        }
+    };
+    if (M * N * K >= GEMM_PARALLEL_WORK)
+        parallelChunks(blocks,
+                       max(size_t(1),
+                           blocks / (4 * ThreadPool::global().size())),
+                       rows);
+    else
+        rows(0, blocks);
+}
+}  // namespace detail
+
+/**
+ * Base of everything that can stand as a matrix operand: Matrix, MatrixView
+ * and the lazy nodes built by the arithmetic operators. A node only
+ * computes its elements when it is assigned to a Matrix or a view, or
+ * converted into a Matrix, so that a chain like a + b - c * 2 runs as one
+ * fused pass over the data.
+ *
+ * Every expression E provides value_type, rowLength(), columnLength(),
+ * coeff(i, j), and
+ *  - contiguous(): whether coeff(k) gives the k-th element in row-major
+ *    order, i.e. every operand is a dense row-major block;
+ *  - aliases(dst, elementwise): whether writing dst may clobber an operand
+ *    before it is read. With elementwise set, an operand laid out exactly
+ *    like dst does not count, since element (i, j) of the result only
+ *    reads element (i, j) of it;
+ *  - evalTo(dst): writes every element into the MatrixView dst.
+ */
+template <class E>
+struct MatrixExpr {
+    const E& self() const { return static_cast<const E&>(*this); }
+};
+
+// the order in which a Matrix stores its elements
+enum Layout { ROW_MAJOR, COLUMN_MAJOR };
+
+template <class T,
+          class Allocator = AlignedAllocator<T>,
+          Layout L = ROW_MAJOR>
+class Matrix;
+
+template <class T>
+class MatrixView;
+
+template <class T, size_t R, size_t C>
+class FixedMatrix;
+
+template <class T, class Index = size_t>
+class CsrMatrix;
+
+template <class T, class Index = size_t>
+class CscMatrix;
+
+template <class E>
+struct IsMatrixExpr {
+    static constexpr bool value =
+        std::is_base_of<MatrixExpr<E>, E>::value;
+};
+
+template <class E>
+struct IsMatrix {
+    static constexpr bool value = false;
+};
+
+template <class T, class A, Layout L>
+struct IsMatrix<Matrix<T, A, L>> {
+    static constexpr bool value = true;
+};
+
+// operands backed by strided memory: data(), rowStride() and colStride()
+template <class E>
+struct IsDense {
+    static constexpr bool value = IsMatrix<E>::value;
+};
+
+template <class T>
+struct IsDense<MatrixView<T>> {
+    static constexpr bool value = true;
+};
+
+template <class E>
+struct IsFixed {
+    static constexpr bool value = false;
+};
+
+template <class T, size_t R, size_t C>
+struct IsFixed<FixedMatrix<T, R, C>> {
+    static constexpr bool value = true;
+};
+
+template <class T, size_t R, size_t C>
+struct IsDense<FixedMatrix<T, R, C>> {
+    static constexpr bool value = true;
+};
+
+template <class S>
+struct IsSparse {
+    static constexpr bool value = false;
+};
+
+template <class T, class I>
+struct IsSparse<CsrMatrix<T, I>> {
+    static constexpr bool value = true;
+};
+
+template <class T, class I>
+struct IsSparse<CscMatrix<T, I>> {
+    static constexpr bool value = true;
+};
+
+/**
+ * Element types whose arithmetic is exact, so that reassociating a product
+ * (e.g. Strassen-Winograd) cannot change the result. Specialize it for
+ * user types such as modular integers.
+ */
+template <class T>
+struct IsExact {
+    static constexpr bool value =
+        std::is_integral<T>::value && !std::is_same<T, bool>::value;
+};
+
+/**
+ * Residues modulo a compile-time Mod below 2^31, e.g. 1e9 + 7 or an NTT
+ * prime. Products of ModInt matrices go through a modular GEMM that sums
+ * in 64 bits and reduces once per element, not once per multiply-add.
+ */
+template <std::uint32_t Mod>
+class ModInt {
+    static_assert(Mod >= 1 && Mod < (std::uint32_t(1) << 31),
+                  "the modulus must be in [1, 2^31)");
+
+   private:
+    std::uint32_t v;
+
+   public:
+    static constexpr std::uint32_t modulus = Mod;
+
+    constexpr ModInt() : v(0) {}
+
+    template <class I,
+              class = typename std::enable_if<std::is_integral<I>::value>::type>
+    constexpr ModInt(I x) : v(0) {
+        if constexpr (std::is_signed<I>::value) {
+            const long long r = (long long)x % (long long)Mod;
+            v = std::uint32_t(r < 0 ? r + Mod : r);
+        } else {
+            v = std::uint32_t((unsigned long long)x % Mod);
+        }
+    }
+
+    constexpr std::uint32_t value() const { return v; }
+
+    constexpr explicit operator std::uint32_t() const { return v; }
+
+    constexpr ModInt& operator+=(const ModInt& o) {
+        v += o.v;
+        if (v >= Mod)
+            v -= Mod;
+        return *this;
+    }
+
+    constexpr ModInt& operator-=(const ModInt& o) {
+        v = v >= o.v ? v - o.v : v + (Mod - o.v);
+        return *this;
+    }
+
+    constexpr ModInt& operator*=(const ModInt& o) {
+        v = std::uint32_t(std::uint64_t(v) * o.v % Mod);
+        return *this;
+    }
+
+    constexpr ModInt operator-() const { return ModInt() - *this; }
+
+    friend constexpr ModInt operator+(ModInt a, const ModInt& b) {
+        return a += b;
+    }
+
+    friend constexpr ModInt operator-(ModInt a, const ModInt& b) {
+        return a -= b;
+    }
+
+    friend constexpr ModInt operator*(ModInt a, const ModInt& b) {
+        return a *= b;
+    }
+
+    friend constexpr bool operator==(const ModInt& a, const ModInt& b) {
+        return a.v == b.v;
+    }
+
+    friend constexpr bool operator!=(const ModInt& a, const ModInt& b) {
+        return a.v != b.v;
+    }
+};
+
+template <std::uint32_t Mod>
+struct IsExact<ModInt<Mod>> {
+    static constexpr bool value = true;
+};
+
+template <class T>
+struct IsModInt {
+    static constexpr bool value = false;
+};
+
+template <std::uint32_t Mod>
+struct IsModInt<ModInt<Mod>> {
+    static constexpr bool value = true;
+};
+
+namespace detail {
+/**
+ * Whether the r x c block at p with strides (rs, cs) overlaps dst. With
+ * elementwise set, a block laid out exactly like dst does not count.
+ */
+template <class T, class U>
+bool overlaps(const T* p,
+              size_t r,
+              size_t c,
+              size_t rs,
+              size_t cs,
+              const MatrixView<U>& dst,
+              bool elementwise) {
+    if (r == 0 || c == 0 || dst.rowLength() == 0 || dst.columnLength() == 0)
+        return false;
+    const char* lo = reinterpret_cast<const char*>(p);
+    const char* hi =
+        reinterpret_cast<const char*>(p + (r - 1) * rs + (c - 1) * cs + 1);
+    const char* dlo = reinterpret_cast<const char*>(dst.data());
+    const char* dhi = reinterpret_cast<const char*>(
+        dst.data() + (dst.rowLength() - 1) * dst.rowStride() +
+        (dst.columnLength() - 1) * dst.colStride() + 1);
+    if (hi <= dlo || dhi <= lo)
+        return false;
+    return !(elementwise && lo == dlo && sizeof(T) == sizeof(U) &&
+             r == dst.rowLength() && c == dst.columnLength() &&
+             rs == dst.rowStride() && cs == dst.colStride());
+}
+
+// f(i) for every row, spread over the pool when there are many elements
+template <class T, class F>
+void rowwise(size_t r, size_t c, const F& f) {
+    if (std::is_arithmetic<T>::value && r * c >= 2 * ELEMENTWISE_GRAIN) {
+        parallelChunks(r, max(size_t(1), ELEMENTWISE_GRAIN / max(c, size_t(1))),
+                       [&](size_t l, size_t h) {
+                           for (size_t i = l; i < h; i++)
+                               f(i);
+                       });
+    } else {
+        for (size_t i = 0; i < r; i++)
+            f(i);
+    }
+}
+
+/**
+ * f(offset..., len) over the rows of dense operands whose column stride is
+ * one, where offset is the start of a run of len elements in each of
+ * them. A single run covers everything when all of them are contiguous.
+ * If instead every row stride is one, the runs are the columns. Returns
+ * false, doing nothing, if neither holds.
+ */
+template <class T, class F, class... Es>
+bool denseRuns(const MatrixView<T>& dst, const F& f, const Es&... es) {
+    const size_t r = dst.rowLength(), c = dst.columnLength();
+    bool unit = dst.colStride() == 1, contiguous = dst.contiguous();
+    for (bool u : {es.colStride() == 1 ...})
+        unit = unit && u;
+    for (bool u : {es.contiguous()...})
+        contiguous = contiguous && u;
+    if (!unit) {
+        bool columns = dst.rowStride() == 1 && r > 1,
+             whole = dst.colStride() == r;
+        for (bool u : {es.rowStride() == 1 ...})
+            columns = columns && u;
+        for (bool u : {es.colStride() == r...})
+            whole = whole && u;
+        if (!columns)
+            return false;
+        if (whole)
+            f(dst.data(), es.data()..., r * c);
+        else
+            rowwise<T>(c, r, [&](size_t j) {
+                f(dst.data() + j * dst.colStride(),
+                  es.data() + j * es.colStride()..., r);
+            });
+        return true;
+    }
+    if (contiguous) {
+        f(dst.data(), es.data()..., r * c);
+    } else {
+        rowwise<T>(r, c, [&](size_t i) {
+            f(dst.data() + i * dst.rowStride(),
+              es.data() + i * es.rowStride()..., c);
+        });
+    }
+    return true;
+}
+
+// dst(i, j) = e.coeff(i, j) for the whole expression, in one pass
+template <class T, class E>
+void evaluate(const MatrixView<T>& dst, const E& e) {
+    const size_t r = dst.rowLength(), c = dst.columnLength();
+    if (dst.contiguous() && e.contiguous()) {
+        T* d = dst.data();
+        elementwise<T>(r * c, [&](size_t l, size_t h) {
+            for (size_t k = l; k < h; k++)
+                d[k] = T(e.coeff(k));
+        });
+    } else if (dst.rowStride() == 1 && r > 1) {
+        // column by column, so that a column-major dst is written in order
+        rowwise<T>(c, r, [&](size_t j) {
+            for (size_t i = 0; i < r; i++)
+                dst.coeff(i, j) = T(e.coeff(i, j));
+        });
+    } else {
+        rowwise<T>(r, c, [&](size_t i) {
+            for (size_t j = 0; j < c; j++)
+                dst.coeff(i, j) = T(e.coeff(i, j));
+        });
+    }
+}
+
+// evaluates e into dst, through a temporary if dst overlaps an operand
+template <class T, class E>
+void assign(const MatrixView<T>& dst, const E& e) {
+    if (e.aliases(dst, true)) {
+        const Matrix<typename E::value_type> tmp(e);
+        tmp.evalTo(dst);
+    } else {
+        e.evalTo(dst);
+    }
+}
+}  // namespace detail
+
+/**
+ * A non-owning window into strided storage: element (i, j) lives at
+ * data()[i * rowStride() + j * colStride()]. Views of a Matrix come from
+ * Matrix::view(), rowView(), columnView() and block(); they are only valid
+ * while the Matrix keeps its storage. MatrixView<const T> is read-only.
+ *
+ * Copying a view copies the window. Assigning to a view, on the other
+ * hand, writes through it like assigning to a reference, so that
+ * a.rowView(0) = b.rowView(1) copies a row of b into a; like a reference,
+ * a const view still writes to non-const elements.
+ */
+template <class T>
+class MatrixView : public MatrixExpr<MatrixView<T>> {
+   private:
+    T* p;
+    size_t R, C, rs, cs;
+
+   public:
+    typedef typename std::remove_const<T>::type value_type;
+
+    MatrixView() : p(NULL), R(0), C(0), rs(0), cs(1) {}
+
+    // a row-major block with leading dimension ld
+    MatrixView(T* data, size_t rows, size_t cols, size_t ld)
+        : p(data), R(rows), C(cols), rs(ld), cs(1) {}
+
+    MatrixView(T* data,
+               size_t rows,
+               size_t cols,
+               size_t rowStride,
+               size_t colStride)
+        : p(data), R(rows), C(cols), rs(rowStride), cs(colStride) {}
+
+    MatrixView(const MatrixView& o) = default;
+
+    template <class U,
+              class = typename std::enable_if<
+                  std::is_same<const U, T>::value>::type>
+    MatrixView(const MatrixView<U>& o)
+        : p(o.data()),
+          R(o.rowLength()),
+          C(o.columnLength()),
+          rs(o.rowStride()),
+          cs(o.colStride()) {}
+
+    const MatrixView& operator=(const MatrixView& o) const {
+        if (R != o.R || C != o.C) {
+            throw std::invalid_argument("assignment between invalid matrices");
+        }
+        detail::assign(*this, o);
+        return *this;
+    }
+
+    template <class E>
+    const MatrixView& operator=(const MatrixExpr<E>& e) const {
+        if (R != e.self().rowLength() || C != e.self().columnLength()) {
+            throw std::invalid_argument("assignment between invalid matrices");
+        }
+        detail::assign(*this, e.self());
+        return *this;
+    }
+
+    template <class E>
+    const MatrixView& operator+=(const MatrixExpr<E>& e) const {
+        return *this = *this + e.self();
+    }
+
+    template <class E>
+    const MatrixView& operator-=(const MatrixExpr<E>& e) const {
+        return *this = *this - e.self();
+    }
+
+    template <class U>
+    const MatrixView& operator*=(const U& x) const {
+        return *this = *this * x;
+    }
+
+    size_t rowLength() const { return R; }
+    size_t columnLength() const { return C; }
+    std::pair<size_t, size_t> size() const { return std::make_pair(R, C); }
+    size_t Size() const { return R * C; }
+
+    T* data() const { return p; }
+    size_t rowStride() const { return rs; }
+    size_t colStride() const { return cs; }
+    bool contiguous() const { return cs == 1 && (rs == C || R <= 1); }
+
+    MatrixView view() const { return *this; }
+
+    T& coeff(size_t i, size_t j) const { return p[i * rs + j * cs]; }
+    T& coeff(size_t k) const { return p[k]; }
+
+    T& operator()(size_t i, size_t j) const {
+        detail::checkIndex(i < R && j < C);
+        return p[i * rs + j * cs];
+    }
+
+    T& at(size_t i, size_t j) const {
+        detail::checkIndexAlways(i < R && j < C);
+        return p[i * rs + j * cs];
+    }
+
+    MatrixView rowView(size_t i) const {
+        if (i >= R) {
+            throw std::invalid_argument("out of range");
+        }
+        return MatrixView(p + i * rs, 1, C, rs, cs);
+    }
+
+    MatrixView columnView(size_t j) const {
+        if (j >= C) {
+            throw std::invalid_argument("out of range");
+        }
+        return MatrixView(p + j * cs, R, 1, rs, 1);
+    }
+
+    // the rows x cols block whose top left corner is (i, j)
+    MatrixView block(size_t i, size_t j, size_t rows, size_t cols) const {
+        if (i + rows > R || j + cols > C) {
+            throw std::invalid_argument("invalid submatrix");
+        }
+        return MatrixView(p + i * rs + j * cs, rows, cols, rs, cs);
+    }
+
+    // the same elements with rows and columns swapped; nothing is copied
+    MatrixView tran() const { return MatrixView(p, C, R, cs, rs); }
+
+    template <class U>
+    bool aliases(const MatrixView<U>& dst, bool elementwise) const {
+        return detail::overlaps(p, R, C, rs, cs, dst, elementwise);
+    }
+
+    // a view laid out across dst, as a transposed one usually is, goes
+    // through the blocked transpose rather than a strided copy
+    template <class U>
+    void evalTo(const MatrixView<U>& dst) const {
+        if constexpr (std::is_same<value_type, U>::value) {
+            if (detail::denseRuns(
+                    dst,
+                    [](U* d, const T* s, size_t n) {
+                        if (d != s)
+                            std::copy(s, s + n, d);
+                    },
+                    *this))
+                return;
+            if (R > 1 && C > 1 && rs == 1 && dst.colStride() == 1) {
+                SJTU_COUNT_OP(stats::TRANSPOSE, R * C, 0);
+                detail::transpose(p, C, R, cs, dst.data(), dst.rowStride());
+                return;
+            }
+            if (R > 1 && C > 1 && cs == 1 && dst.rowStride() == 1) {
+                SJTU_COUNT_OP(stats::TRANSPOSE, R * C, 0);
+                detail::transpose(p, R, C, rs, dst.data(), dst.colStride());
+                return;
+            }
+        }
+        detail::evaluate(dst, *this);
+    }
+};
+
+/**
+ * Storage comes from Allocator; the default aligns it to a cache line, and
+ * HugePageAllocator<T> backs big matrices with transparent huge pages.
+ *
+ * L orders the elements: ROW_MAJOR, the default, keeps each row together
+ * and COLUMN_MAJOR each column, for code that mostly walks columns.
+ * Indexing by (i, j) means the same either way; data(), operator[] and
+ * the iterators follow the storage. Matrices of either layout mix freely
+ * in expressions and products.
+ */
+template <class T, class Allocator, Layout L>
+class Matrix : public MatrixExpr<Matrix<T, Allocator, L>> {
+    template <class U, class B, Layout M>
+    friend class Matrix;
+
+   private:
+    Vector<T, 2, 8, Allocator> Data;
+    size_t R, C;
+
+    // where element (i, j) lives in Data
+    size_t offset(size_t i, size_t j) const {
+        return L == ROW_MAJOR ? i * C + j : j * R + i;
+    }
+
+   public:
+    typedef T value_type;
+    typedef Allocator allocator_type;
+    typedef Matrix<T, Allocator, L == ROW_MAJOR ? COLUMN_MAJOR : ROW_MAJOR>
+        transpose_type;
+    static constexpr Layout layout = L;
+
+    Matrix() : Data(), R(0), C(0) {}
+
+    explicit Matrix(const Allocator& alloc) : Data(alloc), R(0), C(0) {}
+
+    Matrix(size_t n,
+           size_t m,
+           T _init = T(),
+           const Allocator& alloc = Allocator())
+        : Data(alloc), R(n), C(m) {
+        Data.assign(R * C, _init);
+    }
+
+    explicit Matrix(std::pair<size_t, size_t> sz,
+                    T _init = T(),
+                    const Allocator& alloc = Allocator())
+        : Data(alloc), R(sz.first), C(sz.second) {
+        Data.assign(R * C, _init);
+    }
+
+    Matrix(const Matrix& o) : Data(o.Data), R(o.R), C(o.C) {}
+
+    template <class U, class B, Layout M>
+    Matrix(const Matrix<U, B, M>& o) : Data(o.R * o.C), R(o.R), C(o.C) {
+        if constexpr (M != L) {
+            o.view().evalTo(view());
+        } else {
+            for (size_t i = 0; i < R * C; i++) {
+                Data[i] = T(o.coeff(i));
+            }
+        }
+    }
+
+    Matrix& operator=(const Matrix& o) {
+        R = o.R;
+        C = o.C;
+        Data = o.Data;
+        return *this;
+    }
+
+    template <class U, class B, Layout M>
+    Matrix& operator=(const Matrix<U, B, M>& o) {
+        R = o.R;
+        C = o.C;
+        Data.resize(R * C);
+        if constexpr (M != L) {
+            o.view().evalTo(view());
+        } else {
+            for (size_t i = 0; i < R * C; i++) {
+                Data[i] = T(o.coeff(i));
+            }
+        }
+        return *this;
+    }
+
+    template <class E,
+              class = typename std::enable_if<!IsMatrix<E>::value>::type>
+    Matrix(const MatrixExpr<E>& e)
+        : Data(e.self().rowLength() * e.self().columnLength()),
+          R(e.self().rowLength()),
+          C(e.self().columnLength()) {
+        e.self().evalTo(view());
+    }
+
+    // evaluates in place unless the shape changes or e overlaps *this
+    template <class E,
+              class = typename std::enable_if<!IsMatrix<E>::value>::type>
+    Matrix& operator=(const MatrixExpr<E>& e) {
+        if (e.self().rowLength() != R || e.self().columnLength() != C) {
+            return *this = Matrix(e);
+        }
+        detail::assign(view(), e.self());
+        return *this;
+    }
+
+    Matrix(Matrix&& o) noexcept : Data(std::move(o.Data)), R(o.R), C(o.C) {}
+
+    Matrix& operator=(Matrix&& o) noexcept {
+        R = o.R;
+        C = o.C;
+        Data = std::move(o.Data);
+        o.Data.stealedClear();
+        return *this;
+    }
+
+    ~Matrix() { Data.clear(); }
+
+    Matrix(std::initializer_list<std::initializer_list<T>> il) {
+        R = il.size();
+        C = il.begin()->size();
+        if constexpr (L == ROW_MAJOR) {
+            Data = Vector<T, 2, 8, Allocator>(il);
+        } else {
+            Data.assign(R * C, T());
+            size_t i = 0;
+            for (const auto& row : il) {
+                if (row.size() != C)
+                    throw std::invalid_argument("invalid initializer list");
+                size_t j = 0;
+                for (const T& x : row)
+                    Data[offset(i, j++)] = x;
+                i++;
+            }
+        }
+    }
+
+   public:
+    size_t rowLength() const { return R; }
+
+    size_t columnLength() const { return C; }
+
+    T& operator[](const size_t x) {
+        detail::checkIndex(x < Data.size());
+        return Data[x];
+    }
+    const T& operator[](const size_t x) const {
+        detail::checkIndex(x < Data.size());
+        return Data[x];
+    }
+
+    // checked whatever SJTU_MATRIX_CHECK_BOUNDS says
+    T& at(const size_t x) {
+        detail::checkIndexAlways(x < Data.size());
+        return Data[x];
+    }
+    const T& at(const size_t x) const {
+        detail::checkIndexAlways(x < Data.size());
         return Data[x];
     }
-    const T& operator[](const size_t x) const {
-        if (x >= Data.size()) {
+
+    size_t Size() const { return R * C; }
+
+    allocator_type get_allocator() const { return Data.get_allocator(); }
+
+    T* data() { return Data.data(); }
+    const T* data() const { return Data.data(); }
+
+    size_t rowStride() const { return L == ROW_MAJOR ? C : 1; }
+    size_t colStride() const { return L == ROW_MAJOR ? 1 : R; }
+    bool contiguous() const { return L == ROW_MAJOR; }
+
+    // unchecked element access, for expression evaluation
+    const T& coeff(size_t i, size_t j) const { return Data[offset(i, j)]; }
+    const T& coeff(size_t k) const { return Data[k]; }
+
+    template <class U>
+    bool aliases(const MatrixView<U>& dst, bool elementwise) const {
+        return detail::overlaps(data(), R, C, rowStride(), colStride(), dst,
+                                elementwise);
+    }
+
+    template <class U>
+    void evalTo(const MatrixView<U>& dst) const {
+        view().evalTo(dst);
+    }
+
+    MatrixView<T> view() {
+        return MatrixView<T>(data(), R, C, rowStride(), colStride());
+    }
+    MatrixView<const T> view() const {
+        return MatrixView<const T>(data(), R, C, rowStride(), colStride());
+    }
+
+    MatrixView<T> rowView(size_t i) { return view().rowView(i); }
+    MatrixView<const T> rowView(size_t i) const { return view().rowView(i); }
+
+    MatrixView<T> columnView(size_t j) { return view().columnView(j); }
+    MatrixView<const T> columnView(size_t j) const {
+        return view().columnView(j);
+    }
+
+    // the rows x cols block whose top left corner is (i, j)
+    MatrixView<T> block(size_t i, size_t j, size_t rows, size_t cols) {
+        return view().block(i, j, rows, cols);
+    }
+    MatrixView<const T> block(size_t i,
+                              size_t j,
+                              size_t rows,
+                              size_t cols) const {
+        return view().block(i, j, rows, cols);
+    }
+
+    void resize(size_t _n, size_t _m, T _init = T()) {
+        Data.resize(_n * _m, _init);
+        R = _n, C = _m;
+    }
+
+    void resize(std::pair<size_t, size_t> sz, T _init = T()) {
+        Data.resize(sz.first * sz.second, _init);
+        R = sz.first, C = sz.second;
+    }
+
+    std::pair<size_t, size_t> size() const { return std::make_pair(R, C); };
+
+    void clear() {
+        R = 0, C = 0;
+        Data.clear();
+    }
+
+   public:
+    const T& operator()(size_t i, size_t j) const {
+        detail::checkIndex(i < R && j < C);
+        return Data[offset(i, j)];
+    }
+
+    T& operator()(size_t i, size_t j) {
+        detail::checkIndex(i < R && j < C);
+        return Data[offset(i, j)];
+    }
+
+    const T& at(size_t i, size_t j) const {
+        detail::checkIndexAlways(i < R && j < C);
+        return Data[offset(i, j)];
+    }
+
+    T& at(size_t i, size_t j) {
+        detail::checkIndexAlways(i < R && j < C);
+        return Data[offset(i, j)];
+    }
+
+    Matrix row(size_t i) const { return Matrix(rowView(i)); }
+
+    Matrix column(size_t i) const { return Matrix(columnView(i)); }
+
+   public:
+    template <class U, class B, Layout M>
+    bool operator==(const Matrix<U, B, M>& o) const {
+        if constexpr (M != L)
+            return view() == o.view();
+        else
+            return R == o.R && C == o.C && Data == o.Data;  // XXX
+    }
+
+    template <class U, class B, Layout M>
+    bool operator!=(const Matrix<U, B, M>& o) const {
+        return !(*this == o);
+    }
+
+    template <class E>
+    Matrix& operator+=(const MatrixExpr<E>& e) {
+        view() += e.self();
+        return *this;
+    }
+
+    template <class E>
+    Matrix& operator-=(const MatrixExpr<E>& e) {
+        view() -= e.self();
+        return *this;
+    }
+
+    template <class U>
+    Matrix& operator*=(const U& x) {
+        detail::scaleArray(Data.data(), Data.data(), x, Data.size());
+        return *this;
+    }
+
+    // transposes without a second buffer; square matrices go tile by tile
+    void transposeInPlace() {
+        if (R == C) {
+            detail::transposeSquareInPlace(data(), R, C);
+        } else {
+            if (L == ROW_MAJOR)
+                detail::transposeCyclesInPlace(data(), R, C);
+            else
+                detail::transposeCyclesInPlace(data(), C, R);
+            swap(R, C);
+        }
+    }
+
+    /**
+     * A view of the transpose over this matrix's storage, valid as long as
+     * the matrix is. Products and elementwise operators read it in place,
+     * so a.tran() * b copies nothing; it is only transposed for real when
+     * assigned to a Matrix.
+     */
+    MatrixView<const T> tran() const& {
+        return MatrixView<const T>(data(), C, R, colStride(), rowStride());
+    }
+
+    // a temporary gives its storage away: A row-major is A^T column-major
+    transpose_type tran() && {
+        transpose_type ret;
+        ret.Data = std::move(Data);
+        ret.R = C, ret.C = R;
+        R = C = 0;
+        return ret;
+    }
+
+   public:  // iterator
+    /**
+     * Walks a block of the matrix row by row with pointer bumps: one
+     * increment and one compare per step, and O(1) jumps. begin()/end()
+     * see the whole matrix as a single row, so that iterating it never
+     * leaves the fast path; subMatrix() adds a skip to the next row. In a
+     * COLUMN_MAJOR matrix, read column for row.
+     */
+    template <class U>
+    class Iterator {
+       public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = typename std::remove_const<U>::type;
+        using pointer = U*;
+        using reference = U&;
+        using size_type = size_t;
+        using difference_type = std::ptrdiff_t;
+
+       private:
+        U* p = nullptr;
+        size_t col = 0, width = 1, skip = 0;
+
+        friend class Matrix;
+        template <class V>
+        friend class Iterator;
+
+        // at p, the start of a row of width elements, rows ld apart
+        Iterator(U* _p, size_t _width, size_t ld)
+            : p(_p), col(0), width(max(_width, size_t(1))), skip(ld - _width) {}
+
+       public:
+        Iterator() = default;
+
+        // iterator to const_iterator
+        template <class V,
+                  class = typename std::enable_if<
+                      std::is_same<const V, U>::value>::type>
+        Iterator(const Iterator<V>& o)
+            : p(o.p), col(o.col), width(o.width), skip(o.skip) {}
+
+        reference operator*() const { return *p; }
+
+        pointer operator->() const { return p; }
+
+        reference operator[](difference_type n) const { return *(*this + n); }
+
+        Iterator& operator++() {
+            ++p;
+            if (++col == width) {
+                col = 0;
+                p += skip;
+            }
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator ret(*this);
+            ++*this;
+            return ret;
+        }
+
+        Iterator& operator--() {
+            if (col == 0) {
+                col = width;
+                p -= skip;
+            }
+            --col;
+            --p;
+            return *this;
+        }
+
+        Iterator operator--(int) {
+            Iterator ret(*this);
+            --*this;
+            return ret;
+        }
+
+        Iterator& operator+=(difference_type n) {
+            const difference_type w = difference_type(width);
+            difference_type c = difference_type(col) + n, rows = c / w;
+            c %= w;
+            if (c < 0)
+                c += w, rows--;
+            p += rows * difference_type(skip) + (c - difference_type(col)) +
+                 rows * w;
+            col = size_t(c);
+            return *this;
+        }
+
+        Iterator& operator-=(difference_type n) { return *this += -n; }
+
+        Iterator operator+(difference_type n) const {
+            Iterator ret(*this);
+            return ret += n;
+        }
+
+        friend Iterator operator+(difference_type n, const Iterator& it) {
+            return it + n;
+        }
+
+        Iterator operator-(difference_type n) const {
+            Iterator ret(*this);
+            return ret += -n;
+        }
+
+        difference_type operator-(const Iterator& o) const {
+            const difference_type ld = difference_type(width + skip);
+            const difference_type rows = ((p - col) - (o.p - o.col)) / ld;
+            return rows * difference_type(width) + difference_type(col) -
+                   difference_type(o.col);
+        }
+
+        // positions in one block only grow with the address
+        bool operator==(const Iterator& o) const { return p == o.p; }
+        bool operator!=(const Iterator& o) const { return p != o.p; }
+        bool operator<(const Iterator& o) const { return p < o.p; }
+        bool operator>(const Iterator& o) const { return p > o.p; }
+        bool operator<=(const Iterator& o) const { return p <= o.p; }
+        bool operator>=(const Iterator& o) const { return p >= o.p; }
+    };
+
+    typedef Iterator<T> iterator;
+    typedef Iterator<const T> const_iterator;
+
+    iterator begin() { return iterator(data(), Size(), Size()); }
+    iterator end() { return begin() + std::ptrdiff_t(Size()); }
+
+    const_iterator begin() const {
+        return const_iterator(data(), Size(), Size());
+    }
+    const_iterator end() const { return begin() + std::ptrdiff_t(Size()); }
+
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+    // the block with corners l and r, both inclusive, in storage order
+    std::pair<iterator, iterator> subMatrix(std::pair<size_t, size_t> l,
+                                            std::pair<size_t, size_t> r) {
+        const std::pair<const_iterator, const_iterator> c =
+            static_cast<const Matrix&>(*this).subMatrix(l, r);
+        const size_t ld = L == ROW_MAJOR ? C : R;
+        return std::make_pair(iterator(data() + (c.first.p - data()),
+                                       c.first.width, ld),
+                              iterator(data() + (c.second.p - data()),
+                                       c.first.width, ld));
+    }
+
+    std::pair<const_iterator, const_iterator> subMatrix(
+        std::pair<size_t, size_t> l,
+        std::pair<size_t, size_t> r) const {
+        if (l.first > r.first || l.second > r.second || r.first >= R ||
+            r.second >= C) {
+            throw std::invalid_argument("invalid submatrix");
+        }
+        const size_t rows = r.first - l.first + 1,
+                     cols = r.second - l.second + 1;
+        const size_t ld = L == ROW_MAJOR ? C : R;
+        const_iterator first(data() + offset(l.first, l.second),
+                             L == ROW_MAJOR ? cols : rows, ld);
+        const_iterator last(first);
+        last.p += (L == ROW_MAJOR ? rows : cols) * ld;
+        return std::make_pair(first, last);
+    }
+};
+
+}  // namespace sjtu
+
+//
+namespace sjtu {
+namespace detail {
+template <class E>
+using ExprType = typename std::decay<E>::type;
+
+// nodes keep lvalue matrices by reference and everything else by value
+template <class E>
+using Operand = typename std::conditional<
+    IsMatrix<ExprType<E>>::value && std::is_lvalue_reference<E>::value,
+    const ExprType<E>&,
+    ExprType<E>>::type;
+
+// FixedMatrix with FixedMatrix has its own operators
+template <class L, class R>
+using EnableIfExprs = typename std::enable_if<
+    IsMatrixExpr<ExprType<L>>::value && IsMatrixExpr<ExprType<R>>::value &&
+    !(IsFixed<ExprType<L>>::value && IsFixed<ExprType<R>>::value)>::type;
+
+template <class E, class U>
+using EnableIfScalar = typename std::enable_if<
+    IsMatrixExpr<ExprType<E>>::value && !IsFixed<ExprType<E>>::value &&
+    !IsMatrixExpr<ExprType<U>>::value && !IsSparse<ExprType<U>>::value>::type;
+
+struct AddOp {
+    static constexpr stats::Op id = stats::ADD;
+    template <class A, class B>
+    static auto apply(const A& a, const B& b) -> decltype(a + b) {
+        return a + b;
+    }
+    template <class T, class U, class V>
+    static void arrays(T* d, const U* a, const V* b, size_t n) {
+        addArrays(d, a, b, n);
+    }
+};
+
+struct SubOp {
+    static constexpr stats::Op id = stats::SUBTRACT;
+    template <class A, class B>
+    static auto apply(const A& a, const B& b) -> decltype(a - b) {
+        return a - b;
+    }
+    template <class T, class U, class V>
+    static void arrays(T* d, const U* a, const V* b, size_t n) {
+        subArrays(d, a, b, n);
+    }
+};
+
+// dense operands as they are, anything else evaluated into a Matrix
+template <class T, class A, Layout L>
+const Matrix<T, A, L>& materialize(const Matrix<T, A, L>& m) {
+    return m;
+}
+
+template <class T>
+const MatrixView<T>& materialize(const MatrixView<T>& m) {
+    return m;
+}
+
+template <class T, size_t R, size_t C>
+MatrixView<const T> materialize(const FixedMatrix<T, R, C>& m) {
+    return m.view();
+}
+
+template <class E>
+Matrix<typename E::value_type> materialize(const MatrixExpr<E>& e) {
+    return Matrix<typename E::value_type>(e.self());
+}
+
+// c += a * b for dense a and b, where c has the element type of a * b
+template <class T, class A, class B>
+void gemmInto(const MatrixView<T>& c, const A& a, const B& b) {
+    typedef typename A::value_type U;
+    typedef typename B::value_type V;
+    const size_t M = a.rowLength(), K = a.columnLength(), N = b.columnLength();
+    if constexpr (IsModInt<T>::value && std::is_same<T, U>::value &&
+                  std::is_same<T, V>::value) {
+        if (M * N * K >= GEMM_MIN_WORK) {
+            BorrowedWorkspace<std::uint32_t> acc(2, M * N);
+            std::uint32_t* p = acc.data();
+            rowwise<std::uint32_t>(M, N, [&](size_t i) {
+                for (size_t j = 0; j < N; j++)
+                    p[i * N + j] = c.coeff(i, j).value();
+            });
+            modGemm(M, N, K, a.data(), a.rowStride(), a.colStride(), b.data(),
+                    b.rowStride(), b.colStride(), p, N, T::modulus);
+            rowwise<std::uint32_t>(M, N, [&](size_t i) {
+                for (size_t j = 0; j < N; j++)
+                    c.coeff(i, j) = T(p[i * N + j]);
+            });
+            return;
+        }
+    }
+    if constexpr (std::is_arithmetic<U>::value &&
+                  std::is_arithmetic<V>::value) {
+        if (M * N * K >= GEMM_MIN_WORK) {
+            if (c.colStride() == 1) {
+                gemmParallel(M, N, K, a.data(), a.rowStride(), a.colStride(),
+                             b.data(), b.rowStride(), b.colStride(), c.data(),
+                             c.rowStride());
+            } else if (c.rowStride() == 1) {
+                // a column-major c is a row-major c^T = b^T a^T
+                gemmParallel(N, M, K, b.data(), b.colStride(), b.rowStride(),
+                             a.data(), a.colStride(), a.rowStride(), c.data(),
+                             c.colStride());
+            } else {
+                Matrix<T> tmp(M, N, 0);
+                gemmInto(tmp.view(), a, b);
+                c += tmp;
+            }
+            return;
+        }
+    }
+    gemmNaive(M, N, K, a.data(), a.rowStride(), a.colStride(), b.data(),
+              b.rowStride(), b.colStride(), c.data(), c.rowStride(),
+              c.colStride());
+}
+
+struct StrassenTuning {
+    size_t cutoff;     // sub-products this small in any dimension go classic
+    size_t threshold;  // exact products this big in every dimension use it
+};
+
+inline StrassenTuning& strassenTuning() {
+    static StrassenTuning t = {512, 2048};
+    return t;
+}
+
+// z = x + y, or x - y, for m x n row-major blocks
+template <class T>
+void addBlocks(size_t m,
+               size_t n,
+               const T* x,
+               size_t ldx,
+               const T* y,
+               size_t ldy,
+               T* z,
+               size_t ldz,
+               bool subtract) {
+    rowwise<T>(m, n, [&](size_t i) {
+        if (subtract)
+            subArrays(z + i * ldz, x + i * ldx, y + i * ldy, n);
+        else
+            addArrays(z + i * ldz, x + i * ldx, y + i * ldy, n);
+    });
+}
+
+// c = a * b for row-major blocks, by the classical kernels
+template <class T>
+void classicInto(size_t M,
+                 size_t N,
+                 size_t K,
+                 const T* a,
+                 size_t lda,
+                 const T* b,
+                 size_t ldb,
+                 T* c,
+                 size_t ldc) {
+    rowwise<T>(M, N, [&](size_t i) {
+        std::fill(c + i * ldc, c + i * ldc + N, T(0));
+    });
+    gemmInto(MatrixView<T>(c, M, N, ldc), MatrixView<const T>(a, M, K, lda),
+             MatrixView<const T>(b, K, N, ldb));
+}
+
+// scratch for strassen() on an M x K by K x N product
+inline size_t strassenWorkspace(size_t M, size_t N, size_t K, size_t cutoff) {
+    if (min(M, min(N, K)) <= cutoff)
+        return 0;
+    const size_t m = M / 2, n = N / 2, k = K / 2;
+    return m * max(k, n) + k * n + strassenWorkspace(m, n, k, cutoff);
+}
+
+/**
+ * c = a * b for row-major blocks by Strassen-Winograd: 7 half-size
+ * products and 15 additions per level, in the schedule of Douglas et al.
+ * that needs just two temporaries, X and Y, besides the quadrants of c.
+ * M, N and K must stay even down to the cutoff, see strassenPadding();
+ * ws holds strassenWorkspace(M, N, K, cutoff) elements.
+ */
+template <class T>
+void strassen(size_t M,
+              size_t N,
+              size_t K,
+              const T* a,
+              size_t lda,
+              const T* b,
+              size_t ldb,
+              T* c,
+              size_t ldc,
+              T* ws,
+              size_t cutoff) {
+    if (min(M, min(N, K)) <= cutoff) {
+        classicInto(M, N, K, a, lda, b, ldb, c, ldc);
+        return;
+    }
+    const size_t m = M / 2, n = N / 2, k = K / 2;
+    const T *a11 = a, *a12 = a + k, *a21 = a + m * lda, *a22 = a21 + k;
+    const T *b11 = b, *b12 = b + n, *b21 = b + k * ldb, *b22 = b21 + n;
+    T *c11 = c, *c12 = c + n, *c21 = c + m * ldc, *c22 = c21 + n;
+    T* x = ws;                 // m x k, later m x n
+    T* y = x + m * max(k, n);  // k x n
+    T* rest = y + k * n;
+    auto mul = [&](const T* p, size_t ldp, const T* q, size_t ldq, T* r,
+                   size_t ldr) {
+        strassen(m, n, k, p, ldp, q, ldq, r, ldr, rest, cutoff);
+    };
+    addBlocks(m, k, a11, lda, a21, lda, x, k, true);  // S3 = A11 - A21
+    addBlocks(k, n, b22, ldb, b12, ldb, y, n, true);  // T3 = B22 - B12
+    mul(x, k, y, n, c21, ldc);                        // P7 = S3 T3
+    addBlocks(m, k, a21, lda, a22, lda, x, k, false); // S1 = A21 + A22
+    addBlocks(k, n, b12, ldb, b11, ldb, y, n, true);  // T1 = B12 - B11
+    mul(x, k, y, n, c22, ldc);                        // P5 = S1 T1
+    addBlocks(m, k, x, k, a11, lda, x, k, true);      // S2 = S1 - A11
+    addBlocks(k, n, b22, ldb, y, n, y, n, true);      // T2 = B22 - T1
+    mul(x, k, y, n, c12, ldc);                        // P6 = S2 T2
+    addBlocks(m, k, a12, lda, x, k, x, k, true);      // S4 = A12 - S2
+    mul(x, k, b22, ldb, c11, ldc);                    // P3 = S4 B22
+    mul(a11, lda, b11, ldb, x, n);                    // P1 = A11 B11
+    addBlocks(m, n, x, n, c12, ldc, c12, ldc, false);     // U2 = P1 + P6
+    addBlocks(m, n, c12, ldc, c21, ldc, c21, ldc, false); // U3 = U2 + P7
+    addBlocks(m, n, c12, ldc, c22, ldc, c12, ldc, false); // U4 = U2 + P5
+    addBlocks(m, n, c21, ldc, c22, ldc, c22, ldc, false); // C22 = U3 + P5
+    addBlocks(m, n, c12, ldc, c11, ldc, c12, ldc, false); // C12 = U4 + P3
+    addBlocks(k, n, y, n, b21, ldb, y, n, true);          // T4 = T2 - B21
+    mul(a22, lda, y, n, c11, ldc);                        // P4 = A22 T4
+    addBlocks(m, n, c21, ldc, c11, ldc, c21, ldc, true);  // C21 = U3 - P4
+    mul(a12, lda, b21, ldb, c11, ldc);                    // P2 = A12 B21
+    addBlocks(m, n, x, n, c11, ldc, c11, ldc, false);     // C11 = P1 + P2
+}
+
+// n rounded up so that it halves evenly as often as strassen() recurses
+inline size_t strassenPadding(size_t n, size_t levels) {
+    const size_t step = size_t(1) << levels;
+    return (n + step - 1) / step * step;
+}
+
+/**
+ * c = a * b by strassen(). Operands whose sizes do not halve evenly all the
+ * way down are copied once into zero-padded buffers, which costs far less
+ * than peeling odd edges at every level; so are ones not row-major.
+ */
+template <class T, class A, class B>
+void strassenInto(const MatrixView<T>& c,
+                  const A& a,
+                  const B& b,
+                  size_t cutoff) {
+    const size_t M = a.rowLength(), K = a.columnLength(), N = b.columnLength();
+    size_t levels = 0;
+    for (size_t m = M, n = N, k = K; min(m, min(n, k)) > cutoff; levels++)
+        m = (m + 1) / 2, n = (n + 1) / 2, k = (k + 1) / 2;
+    const size_t Mp = strassenPadding(M, levels);
+    const size_t Np = strassenPadding(N, levels);
+    const size_t Kp = strassenPadding(K, levels);
+    const bool pad = Mp != M || Np != N || Kp != K;
+    if (pad || a.colStride() != 1 || b.colStride() != 1) {
+        Matrix<T> pa(Mp, Kp, T(0)), pb(Kp, Np, T(0));
+        pa.block(0, 0, M, K) = a;
+        pb.block(0, 0, K, N) = b;
+        if (pad || c.colStride() != 1) {
+            Matrix<T> pc(Mp, Np);
+            strassenInto(pc.view(), pa, pb, cutoff);
+            c = pc.block(0, 0, M, N);
+        } else {
+            strassenInto(c, pa, pb, cutoff);
+        }
+        return;
+    }
+    if (c.colStride() != 1) {
+        Matrix<T> tmp(M, N);
+        strassenInto(tmp.view(), a, b, cutoff);
+        c = tmp;
+        return;
+    }
+    BorrowedWorkspace<T> ws(2, strassenWorkspace(M, N, K, cutoff));
+    strassen(M, N, K, a.data(), a.rowStride(), b.data(), b.rowStride(),
+             c.data(), c.rowStride(), ws.data(), cutoff);
+}
+
+// whether an M x K by K x N product of T goes to Strassen-Winograd unasked
+template <class T>
+bool autoStrassen(size_t M, size_t N, size_t K) {
+    const size_t t = strassenTuning().threshold;
+    return IsExact<T>::value && t && min(M, min(N, K)) >= t;
+}
+
+// c = a * b, for a c that is already zero when cleared is set
+template <class T, class A, class B>
+void productInto(const MatrixView<T>& c,
+                 const A& a,
+                 const B& b,
+                 bool cleared) {
+    if constexpr (std::is_same<typename A::value_type, T>::value &&
+                  std::is_same<typename B::value_type, T>::value) {
+        if (autoStrassen<T>(a.rowLength(), b.columnLength(),
+                            a.columnLength())) {
+            strassenInto(c, a, b, strassenTuning().cutoff);
+            return;
+        }
+    }
+    if (!cleared) {
+        rowwise<T>(c.rowLength(), c.columnLength(), [&](size_t i) {
+            for (size_t j = 0; j < c.columnLength(); j++)
+                c.coeff(i, j) = T(0);
+        });
+    }
+    gemmInto(c, a, b);
+}
+}  // namespace detail
+
+// a op b elementwise, for op in {+, -}
+template <class Op, class L, class R>
+class BinaryExpr : public MatrixExpr<BinaryExpr<Op, L, R>> {
+   private:
+    typedef typename std::decay<L>::type LE;
+    typedef typename std::decay<R>::type RE;
+
+    L lhs;
+    R rhs;
+
+   public:
+    typedef decltype(Op::apply(typename LE::value_type(),
+                               typename RE::value_type())) value_type;
+
+    template <class A, class B>
+    BinaryExpr(A&& a, B&& b, const char* err)
+        : lhs(std::forward<A>(a)), rhs(std::forward<B>(b)) {
+        if (lhs.rowLength() != rhs.rowLength() ||
+            lhs.columnLength() != rhs.columnLength()) {
+            throw std::invalid_argument(err);
+        }
+    }
+
+    size_t rowLength() const { return lhs.rowLength(); }
+    size_t columnLength() const { return lhs.columnLength(); }
+    std::pair<size_t, size_t> size() const {
+        return std::make_pair(rowLength(), columnLength());
+    }
+
+    bool contiguous() const { return lhs.contiguous() && rhs.contiguous(); }
+
+    value_type coeff(size_t i, size_t j) const {
+        return value_type(Op::apply(lhs.coeff(i, j), rhs.coeff(i, j)));
+    }
+    value_type coeff(size_t k) const {
+        return value_type(Op::apply(lhs.coeff(k), rhs.coeff(k)));
+    }
+    value_type operator()(size_t i, size_t j) const {
+        detail::checkIndex(i < rowLength() && j < columnLength());
+        return coeff(i, j);
+    }
+
+    template <class T>
+    bool aliases(const MatrixView<T>& dst, bool elementwise) const {
+        return lhs.aliases(dst, elementwise) || rhs.aliases(dst, elementwise);
+    }
+
+    template <class T>
+    void evalTo(const MatrixView<T>& dst) const {
+        SJTU_COUNT_OP(Op::id, dst.Size(), dst.Size());
+        if constexpr (IsDense<LE>::value && IsDense<RE>::value) {
+            typedef typename LE::value_type U;
+            typedef typename RE::value_type V;
+            if (detail::denseRuns(
+                    dst,
+                    [](T* d, const U* a, const V* b, size_t n) {
+                        Op::arrays(d, a, b, n);
+                    },
+                    lhs, rhs))
+                return;
+        }
+        detail::evaluate(dst, *this);
+    }
+};
+
+// e * x for a scalar x, with the promotion of Matrix<T> * U
+template <class E, class U>
+class ScaleExpr : public MatrixExpr<ScaleExpr<E, U>> {
+   private:
+    typedef typename std::decay<E>::type EE;
+
+    E expr;
+    U x;
+
+   public:
+    typedef decltype(typename EE::value_type() * U()) value_type;
+
+    template <class A>
+    ScaleExpr(A&& a, const U& _x) : expr(std::forward<A>(a)), x(_x) {}
+
+    size_t rowLength() const { return expr.rowLength(); }
+    size_t columnLength() const { return expr.columnLength(); }
+    std::pair<size_t, size_t> size() const {
+        return std::make_pair(rowLength(), columnLength());
+    }
+
+    bool contiguous() const { return expr.contiguous(); }
+
+    value_type coeff(size_t i, size_t j) const {
+        return value_type(value_type(expr.coeff(i, j)) * x);
+    }
+    value_type coeff(size_t k) const {
+        return value_type(value_type(expr.coeff(k)) * x);
+    }
+    value_type operator()(size_t i, size_t j) const {
+        detail::checkIndex(i < rowLength() && j < columnLength());
+        return coeff(i, j);
+    }
+
+    template <class T>
+    bool aliases(const MatrixView<T>& dst, bool elementwise) const {
+        return expr.aliases(dst, elementwise);
+    }
+
+    template <class T>
+    void evalTo(const MatrixView<T>& dst) const {
+        SJTU_COUNT_OP(stats::SCALE, dst.Size(), dst.Size());
+        if constexpr (IsDense<EE>::value &&
+                      std::is_same<typename EE::value_type, T>::value &&
+                      std::is_same<value_type, T>::value) {
+            const U& s = x;
+            if (detail::denseRuns(
+                    dst,
+                    [&s](T* d, const T* a, size_t n) {
+                        detail::scaleArray(d, a, s, n);
+                    },
+                    expr))
+                return;
+        }
+        detail::evaluate(dst, *this);
+    }
+};
+
+// -e elementwise
+template <class E>
+class NegateExpr : public MatrixExpr<NegateExpr<E>> {
+   private:
+    typedef typename std::decay<E>::type EE;
+
+    E expr;
+
+   public:
+    typedef typename EE::value_type value_type;
+
+    template <class A>
+    explicit NegateExpr(A&& a) : expr(std::forward<A>(a)) {}
+
+    size_t rowLength() const { return expr.rowLength(); }
+    size_t columnLength() const { return expr.columnLength(); }
+    std::pair<size_t, size_t> size() const {
+        return std::make_pair(rowLength(), columnLength());
+    }
+
+    bool contiguous() const { return expr.contiguous(); }
+
+    value_type coeff(size_t i, size_t j) const {
+        return value_type(-expr.coeff(i, j));
+    }
+    value_type coeff(size_t k) const { return value_type(-expr.coeff(k)); }
+    value_type operator()(size_t i, size_t j) const {
+        detail::checkIndex(i < rowLength() && j < columnLength());
+        return coeff(i, j);
+    }
+
+    template <class T>
+    bool aliases(const MatrixView<T>& dst, bool elementwise) const {
+        return expr.aliases(dst, elementwise);
+    }
+
+    template <class T>
+    void evalTo(const MatrixView<T>& dst) const {
+        SJTU_COUNT_OP(stats::NEGATE, dst.Size(), dst.Size());
+        if constexpr (IsDense<EE>::value &&
+                      std::is_same<value_type, T>::value) {
+            if (detail::denseRuns(
+                    dst,
+                    [](T* d, const T* a, size_t n) {
+                        detail::negArray(d, a, n);
+                    },
+                    expr))
+                return;
+        }
+        detail::evaluate(dst, *this);
+    }
+};
+
+template <class E, class U, class = detail::EnableIfScalar<E, U>>
+ScaleExpr<detail::Operand<E>, U> operator*(E&& e, const U& x) {
+    return ScaleExpr<detail::Operand<E>, U>(std::forward<E>(e), x);
+}
+
+template <class E, class U, class = detail::EnableIfScalar<E, U>>
+ScaleExpr<detail::Operand<E>, U> operator*(const U& x, E&& e) {
+    return ScaleExpr<detail::Operand<E>, U>(std::forward<E>(e), x);
+}
+
+template <class L, class R, class = detail::EnableIfExprs<L, R>>
+auto operator*(const L& l, const R& r)
+    -> Matrix<decltype(typename L::value_type() * typename R::value_type())> {
+    using W = decltype(typename L::value_type() * typename R::value_type());
+    if (l.columnLength() != r.rowLength()) {
+        throw std::invalid_argument("multiplication between invalid matrices");
+    }
+    SJTU_COUNT_OP(stats::MULTIPLY, l.rowLength() * r.columnLength(),
+                  2.0 * l.rowLength() * r.columnLength() * l.columnLength());
+    Matrix<W> ret(l.rowLength(), r.columnLength(), 0);
+    detail::productInto(ret.view(), detail::materialize(l),
+                        detail::materialize(r), true);
+    return ret;
+}
+
+/**
+ * dst += a * b, writing straight into dst, which may be a Matrix or a
+ * MatrixView; a and b may be any expressions, views are used in place.
+ */
+template <class D, class L, class R>
+void multiplyAdd(D&& dst, const MatrixExpr<L>& l, const MatrixExpr<R>& r) {
+    typedef typename detail::ExprType<D>::value_type T;
+    using W = decltype(typename L::value_type() * typename R::value_type());
+    const L& a = l.self();
+    const R& b = r.self();
+    if (a.columnLength() != b.rowLength() ||
+        dst.rowLength() != a.rowLength() ||
+        dst.columnLength() != b.columnLength()) {
+        throw std::invalid_argument("multiplication between invalid matrices");
+    }
+    const MatrixView<T> c = dst.view();
+    if (std::is_same<T, W>::value && !a.aliases(c, false) &&
+        !b.aliases(c, false)) {
+        SJTU_COUNT_OP(stats::MULTIPLY, c.Size(),
+                      2.0 * c.Size() * a.columnLength());
+        if constexpr (std::is_same<T, W>::value)
+            detail::gemmInto(c, detail::materialize(a),
+                             detail::materialize(b));
+    } else {
+        c += a * b;
+    }
+}
+
+// dst = a * b, see multiplyAdd(); a Matrix dst is resized if needed
+template <class D, class L, class R>
+void multiply(D&& dst, const MatrixExpr<L>& l, const MatrixExpr<R>& r) {
+    typedef typename detail::ExprType<D>::value_type T;
+    const L& a = l.self();
+    const R& b = r.self();
+    if constexpr (IsMatrix<detail::ExprType<D>>::value) {
+        if (dst.rowLength() != a.rowLength() ||
+            dst.columnLength() != b.columnLength()) {
+            dst = a * b;
+            return;
+        }
+    }
+    const MatrixView<T> c = dst.view();
+    if (a.aliases(c, false) || b.aliases(c, false)) {
+        c = a * b;
+        return;
+    }
+    if (a.columnLength() != b.rowLength() || c.rowLength() != a.rowLength() ||
+        c.columnLength() != b.columnLength()) {
+        throw std::invalid_argument("multiplication between invalid matrices");
+    }
+    using W = decltype(typename L::value_type() * typename R::value_type());
+    if constexpr (std::is_same<T, W>::value) {
+        SJTU_COUNT_OP(stats::MULTIPLY, c.Size(),
+                      2.0 * c.Size() * a.columnLength());
+        detail::productInto(c, detail::materialize(a), detail::materialize(b),
+                            false);
+    } else {
+        detail::rowwise<T>(c.rowLength(), c.columnLength(), [&](size_t i) {
+            for (size_t j = 0; j < c.columnLength(); j++)
+                c.coeff(i, j) = T(0);
+        });
+        multiplyAdd(c, a, b);
+    }
+}
+
+// the size below which strassenMultiply() hands sub-products to the
+// classical kernels
+inline size_t strassenCutoff() {
+    return detail::strassenTuning().cutoff;
+}
+
+inline void setStrassenCutoff(size_t n) {
+    detail::strassenTuning().cutoff = max(n, size_t(1));
+}
+
+// the size from which products of IsExact types use Strassen-Winograd
+// without being asked; 0 turns that off
+inline size_t strassenThreshold() {
+    return detail::strassenTuning().threshold;
+}
+
+inline void setStrassenThreshold(size_t n) {
+    detail::strassenTuning().threshold = n;
+}
+
+/**
+ * a * b by Strassen-Winograd, recursing until a dimension is at most
+ * cutoff (strassenCutoff() by default). About n^2.81 work instead of n^3
+ * on large square-ish products, with scratch bounded by about half the
+ * size of the operands. For floating-point types the result rounds
+ * differently from operator*.
+ */
+template <class L, class R>
+auto strassenMultiply(const MatrixExpr<L>& l,
+                      const MatrixExpr<R>& r,
+                      size_t cutoff = strassenCutoff())
+    -> Matrix<decltype(typename L::value_type() * typename R::value_type())> {
+    using W = decltype(typename L::value_type() * typename R::value_type());
+    if (l.self().columnLength() != r.self().rowLength()) {
+        throw std::invalid_argument("multiplication between invalid matrices");
+    }
+    Matrix<W> ret(l.self().rowLength(), r.self().columnLength());
+    auto dense = [](const auto& e) -> decltype(auto) {
+        typedef typename std::decay<decltype(e)>::type E;
+        if constexpr (std::is_same<typename E::value_type, W>::value)
+            return detail::materialize(e);
+        else
+            return Matrix<W>(e);
+    };
+    detail::strassenInto(ret.view(), dense(l.self()), dense(r.self()),
+                         max(cutoff, size_t(1)));
+    return ret;
+}
+
+namespace detail {
+// m^k for every k in ks, sharing the squarings of m between them; each
+// step writes into one scratch buffer that is then swapped in, so once
+// the first products have grown the per-thread workspaces no product
+// allocates, save Strassen ones on sizes that need padding
+template <class T>
+std::vector<Matrix<T>> powers(Matrix<T> base,
+                              const std::vector<std::uint64_t>& ks) {
+    const size_t n = base.rowLength();
+    if (n != base.columnLength()) {
+        throw std::invalid_argument("power of a non-square matrix");
+    }
+    std::vector<Matrix<T>> ret(ks.size());
+    std::vector<bool> started(ks.size(), false);
+    std::uint64_t top = 0;
+    for (std::uint64_t k : ks)
+        top = max(top, k);
+    Matrix<T> scratch(n, n);
+    for (std::uint64_t bit = 1; bit != 0 && bit <= top; bit <<= 1) {
+        if (bit != 1) {
+            multiply(scratch, base, base);
+            swap(base, scratch);
+        }
+        for (size_t i = 0; i < ks.size(); i++) {
+            if (!(ks[i] & bit))
+                continue;
+            if (!started[i]) {
+                ret[i] = base;
+                started[i] = true;
+            } else {
+                multiply(scratch, ret[i], base);
+                swap(ret[i], scratch);
+            }
+        }
+    }
+    for (size_t i = 0; i < ks.size(); i++) {
+        if (started[i])
+            continue;
+        ret[i] = Matrix<T>(n, n, T(0));
+        for (size_t j = 0; j < n; j++)
+            ret[i].data()[j * n + j] = T(1);
+    }
+    return ret;
+}
+}  // namespace detail
+
+/**
+ * m^k by repeated squaring: at most 2 log2(k) products, each through
+ * multiply() and so through the fastest kernel for the type, ping-ponging
+ * between buffers allocated once. Strassen products (see
+ * setStrassenThreshold()) of sizes that are not a multiple of 2^levels
+ * still pad their operands into fresh buffers.
+ */
+template <class E>
+Matrix<typename E::value_type> pow(const MatrixExpr<E>& m, std::uint64_t k) {
+    SJTU_COUNT_OP(stats::POW, m.self().rowLength() * m.self().columnLength(),
+                  0);
+    return std::move(detail::powers(Matrix<typename E::value_type>(m.self()),
+                                    std::vector<std::uint64_t>{k})[0]);
+}
+
+// m^k for each k, squaring m only as often as the largest k needs
+template <class E>
+std::vector<Matrix<typename E::value_type>> pow(
+    const MatrixExpr<E>& m,
+    const std::vector<std::uint64_t>& ks) {
+    SJTU_COUNT_OP(stats::POW,
+                  ks.size() * m.self().rowLength() * m.self().columnLength(),
+                  0);
+    return detail::powers(Matrix<typename E::value_type>(m.self()), ks);
+}
+
+/**
+ * a * b mod m for integer matrices whose modulus is only known at run
+ * time, through the same modular GEMM as ModInt products. Entries are
+ * reduced into [0, m) first, so negative ones are fine; m must be in
+ * [1, 2^31) and the residues must fit the element type of a.
+ */
+template <class L, class R>
+Matrix<typename L::value_type> multiplyMod(const MatrixExpr<L>& l,
+                                           const MatrixExpr<R>& r,
+                                           std::uint64_t m) {
+    static_assert(std::is_integral<typename L::value_type>::value &&
+                      std::is_integral<typename R::value_type>::value,
+                  "multiplyMod needs integer elements");
+    if (m == 0 || m >= (std::uint64_t(1) << 31)) {
+        throw std::invalid_argument("modulus out of range");
+    }
+    if (l.self().columnLength() != r.self().rowLength()) {
+        throw std::invalid_argument("multiplication between invalid matrices");
+    }
+    auto residues = [m](const auto& e) {
+        typedef typename std::decay<decltype(e)>::type::value_type T;
+        const size_t rows = e.rowLength(), cols = e.columnLength();
+        Matrix<std::uint32_t> ret(rows, cols);
+        std::uint32_t* p = ret.data();
+        detail::rowwise<std::uint32_t>(rows, cols, [&](size_t i) {
+            for (size_t j = 0; j < cols; j++) {
+                const T x = e.coeff(i, j);
+                if constexpr (std::is_signed<T>::value) {
+                    const long long v = (long long)x % (long long)m;
+                    p[i * cols + j] = std::uint32_t(v < 0 ? v + m : v);
+                } else {
+                    p[i * cols + j] = std::uint32_t((unsigned long long)x % m);
+                }
+            }
+        });
+        return ret;
+    };
+    SJTU_COUNT_OP(stats::MULTIPLY_MOD,
+                  l.self().rowLength() * r.self().columnLength(),
+                  2.0 * l.self().rowLength() * r.self().columnLength() *
+                      r.self().rowLength());
+    const Matrix<std::uint32_t> a = residues(l.self()), b = residues(r.self());
+    Matrix<std::uint32_t> c(a.rowLength(), b.columnLength(), 0);
+    detail::modGemm(a.rowLength(), b.columnLength(), a.columnLength(),
+                    a.data(), a.columnLength(), size_t(1), b.data(),
+                    b.columnLength(), size_t(1), c.data(), c.columnLength(),
+                    std::uint32_t(m));
+    return Matrix<typename L::value_type>(c);
+}
+
+template <class L, class R, class = detail::EnableIfExprs<L, R>>
+BinaryExpr<detail::AddOp, detail::Operand<L>, detail::Operand<R>> operator+(
+    L&& a,
+    R&& b) {
+    return BinaryExpr<detail::AddOp, detail::Operand<L>, detail::Operand<R>>(
+        std::forward<L>(a), std::forward<R>(b),
+        "addition between invalid matrices");
+}
+
+template <class L, class R, class = detail::EnableIfExprs<L, R>>
+BinaryExpr<detail::SubOp, detail::Operand<L>, detail::Operand<R>> operator-(
+    L&& a,
+    R&& b) {
+    return BinaryExpr<detail::SubOp, detail::Operand<L>, detail::Operand<R>>(
+        std::forward<L>(a), std::forward<R>(b),
+        "subtraction between invalid matrices");
+}
+
+template <class E,
+          class = typename std::enable_if<
+              IsMatrixExpr<detail::ExprType<E>>::value &&
+              !IsFixed<detail::ExprType<E>>::value>::type>
+NegateExpr<detail::Operand<E>> operator-(E&& e) {
+    return NegateExpr<detail::Operand<E>>(std::forward<E>(e));
+}
+
+// comparisons involving at least one lazy node; Matrix == Matrix and
+// FixedMatrix == FixedMatrix are members
+template <class L,
+          class R,
+          class = typename std::enable_if<
+              !(IsMatrix<L>::value && IsMatrix<R>::value) &&
+              !(IsFixed<L>::value && IsFixed<R>::value)>::type>
+bool operator==(const MatrixExpr<L>& a, const MatrixExpr<R>& b) {
+    const L& l = a.self();
+    const R& r = b.self();
+    if (l.rowLength() != r.rowLength() || l.columnLength() != r.columnLength())
+        return false;
+    for (size_t i = 0; i < l.rowLength(); i++)
+        for (size_t j = 0; j < l.columnLength(); j++)
+            if (l.coeff(i, j) != r.coeff(i, j))
+                return false;
+    return true;
+}
+
+template <class L,
+          class R,
+          class = typename std::enable_if<
+              !(IsMatrix<L>::value && IsMatrix<R>::value) &&
+              !(IsFixed<L>::value && IsFixed<R>::value)>::type>
+bool operator!=(const MatrixExpr<L>& a, const MatrixExpr<R>& b) {
+    return !(a == b);
+}
+
+/**
+ * An R x C matrix with dimensions fixed at compile time and elements
+ * stored inline, for the small sizes where a heap block and runtime shape
+ * checks dominate. Between FixedMatrix operands everything is constexpr,
+ * fully unrolled and shape-checked by the compiler. A FixedMatrix is also
+ * a dense expression, so it mixes with Matrix and MatrixView under the
+ * dynamic rules, and converts to and from Matrix.
+ */
+template <class T, size_t R, size_t C>
+class FixedMatrix : public MatrixExpr<FixedMatrix<T, R, C>> {
+    static_assert(R > 0 && C > 0, "FixedMatrix dimensions must be positive");
+
+    template <class U, size_t R2, size_t C2>
+    friend class FixedMatrix;
+
+   private:
+    T a[R * C];
+
+   public:
+    typedef T value_type;
+    static constexpr size_t ROWS = R;
+    static constexpr size_t COLUMNS = C;
+
+    constexpr FixedMatrix() : a() {}
+
+    constexpr explicit FixedMatrix(const T& _init) : a() {
+        SJTU_UNROLL for (size_t k = 0; k < R * C; k++)
+            a[k] = _init;
+    }
+
+    constexpr FixedMatrix(std::initializer_list<std::initializer_list<T>> il)
+        : a() {
+        if (il.size() != R)
+            throw std::invalid_argument("invalid initializer list");
+        size_t k = 0;
+        for (const auto& row : il) {
+            if (row.size() != C)
+                throw std::invalid_argument("invalid initializer list");
+            for (const T& x : row)
+                a[k++] = x;
+        }
+    }
+
+    template <class U>
+    constexpr FixedMatrix(const FixedMatrix<U, R, C>& o) : a() {
+        SJTU_UNROLL for (size_t k = 0; k < R * C; k++)
+            a[k] = T(o.a[k]);
+    }
+
+    // from a Matrix, view or lazy expression, whose shape must be R x C
+    template <class E,
+              class = typename std::enable_if<!IsFixed<E>::value>::type>
+    explicit FixedMatrix(const MatrixExpr<E>& e) : a() {
+        if (e.self().rowLength() != R || e.self().columnLength() != C) {
+            throw std::invalid_argument("assignment between invalid matrices");
+        }
+        e.self().evalTo(view());
+    }
+
+    static constexpr FixedMatrix identity() {
+        static_assert(R == C, "identity of a non-square matrix");
+        FixedMatrix ret;
+        SJTU_UNROLL for (size_t i = 0; i < R; i++)
+            ret.a[i * C + i] = T(1);
+        return ret;
+    }
+
+    constexpr size_t rowLength() const { return R; }
+    constexpr size_t columnLength() const { return C; }
+    constexpr size_t Size() const { return R * C; }
+    constexpr std::pair<size_t, size_t> size() const {
+        return std::make_pair(R, C);
+    }
+
+    constexpr T& operator()(size_t i, size_t j) {
+        detail::checkIndex(i < R && j < C);
+        return a[i * C + j];
+    }
+    constexpr const T& operator()(size_t i, size_t j) const {
+        detail::checkIndex(i < R && j < C);
+        return a[i * C + j];
+    }
+
+    constexpr T& operator[](size_t k) {
+        detail::checkIndex(k < R * C);
+        return a[k];
+    }
+    constexpr const T& operator[](size_t k) const {
+        detail::checkIndex(k < R * C);
+        return a[k];
+    }
+
+    constexpr T& at(size_t i, size_t j) {
+        detail::checkIndexAlways(i < R && j < C);
+        return a[i * C + j];
+    }
+    constexpr const T& at(size_t i, size_t j) const {
+        detail::checkIndexAlways(i < R && j < C);
+        return a[i * C + j];
+    }
+
+    // element (I, J), with the indices checked at compile time
+    template <size_t I, size_t J>
+    constexpr T& get() {
+        static_assert(I < R && J < C, "index out of range");
+        return a[I * C + J];
+    }
+    template <size_t I, size_t J>
+    constexpr const T& get() const {
+        static_assert(I < R && J < C, "index out of range");
+        return a[I * C + J];
+    }
+
+    constexpr T* data() { return a; }
+    constexpr const T* data() const { return a; }
+
+    constexpr size_t rowStride() const { return C; }
+    constexpr size_t colStride() const { return 1; }
+    constexpr bool contiguous() const { return true; }
+
+    constexpr const T& coeff(size_t i, size_t j) const { return a[i * C + j]; }
+    constexpr const T& coeff(size_t k) const { return a[k]; }
+
+    template <class U>
+    bool aliases(const MatrixView<U>& dst, bool elementwise) const {
+        return detail::overlaps(data(), R, C, C, 1, dst, elementwise);
+    }
+
+    template <class U>
+    void evalTo(const MatrixView<U>& dst) const {
+        view().evalTo(dst);
+    }
+
+    MatrixView<T> view() { return MatrixView<T>(a, R, C, C); }
+    MatrixView<const T> view() const { return MatrixView<const T>(a, R, C, C); }
+
+    constexpr FixedMatrix<T, 1, C> row(size_t i) const {
+        if (i >= R) {
             throw std::invalid_argument("out of range");
         }
-        return Data[x];
+        FixedMatrix<T, 1, C> ret;
+        SJTU_UNROLL for (size_t j = 0; j < C; j++)
+            ret.a[j] = a[i * C + j];
+        return ret;
+    }
+
+    constexpr FixedMatrix<T, R, 1> column(size_t j) const {
+        if (j >= C) {
+            throw std::invalid_argument("out of range");
+        }
+        FixedMatrix<T, R, 1> ret;
+        SJTU_UNROLL for (size_t i = 0; i < R; i++)
+            ret.a[i] = a[i * C + j];
+        return ret;
+    }
+
+    constexpr FixedMatrix<T, C, R> tran() const {
+        FixedMatrix<T, C, R> ret;
+        SJTU_UNROLL for (size_t i = 0; i < R; i++)
+            SJTU_UNROLL for (size_t j = 0; j < C; j++)
+                ret.a[j * R + i] = a[i * C + j];
+        return ret;
+    }
+
+    // differently shaped matrices are never equal, as with Matrix
+    template <class U, size_t R2, size_t C2>
+    constexpr bool operator==(const FixedMatrix<U, R2, C2>& o) const {
+        if constexpr (R2 != R || C2 != C) {
+            return false;
+        } else {
+            for (size_t k = 0; k < R * C; k++)
+                if (a[k] != o.a[k])
+                    return false;
+            return true;
+        }
+    }
+
+    template <class U, size_t R2, size_t C2>
+    constexpr bool operator!=(const FixedMatrix<U, R2, C2>& o) const {
+        return !(*this == o);
+    }
+
+    template <class U, size_t R2, size_t C2>
+    constexpr FixedMatrix& operator+=(const FixedMatrix<U, R2, C2>& o) {
+        static_assert(R == R2 && C == C2, "addition between invalid matrices");
+        SJTU_UNROLL for (size_t k = 0; k < R * C; k++)
+            a[k] += o.a[k];
+        return *this;
+    }
+
+    template <class U, size_t R2, size_t C2>
+    constexpr FixedMatrix& operator-=(const FixedMatrix<U, R2, C2>& o) {
+        static_assert(R == R2 && C == C2,
+                      "subtraction between invalid matrices");
+        SJTU_UNROLL for (size_t k = 0; k < R * C; k++)
+            a[k] -= o.a[k];
+        return *this;
+    }
+
+    template <class U,
+              class = typename std::enable_if<!IsMatrixExpr<U>::value>::type>
+    constexpr FixedMatrix& operator*=(const U& x) {
+        SJTU_UNROLL for (size_t k = 0; k < R * C; k++)
+            a[k] *= x;
+        return *this;
+    }
+
+    template <class U, size_t K, size_t N>
+    constexpr FixedMatrix& operator*=(const FixedMatrix<U, K, N>& o) {
+        static_assert(R == C && K == C && N == C,
+                      "multiplication between invalid matrices");
+        return *this = *this * o;
+    }
+};
+
+template <class T, class U, size_t R, size_t C, size_t R2, size_t C2>
+constexpr auto operator+(const FixedMatrix<T, R, C>& x,
+                         const FixedMatrix<U, R2, C2>& y)
+    -> FixedMatrix<decltype(T() + U()), R, C> {
+    static_assert(R == R2 && C == C2, "addition between invalid matrices");
+    FixedMatrix<decltype(T() + U()), R, C> ret;
+    auto* r = ret.data();
+    SJTU_UNROLL for (size_t k = 0; k < R * C; k++)
+        r[k] = x.coeff(k) + y.coeff(k);
+    return ret;
+}
+
+template <class T, class U, size_t R, size_t C, size_t R2, size_t C2>
+constexpr auto operator-(const FixedMatrix<T, R, C>& x,
+                         const FixedMatrix<U, R2, C2>& y)
+    -> FixedMatrix<decltype(T() - U()), R, C> {
+    static_assert(R == R2 && C == C2, "subtraction between invalid matrices");
+    FixedMatrix<decltype(T() - U()), R, C> ret;
+    auto* r = ret.data();
+    SJTU_UNROLL for (size_t k = 0; k < R * C; k++)
+        r[k] = x.coeff(k) - y.coeff(k);
+    return ret;
+}
+
+template <class T, size_t R, size_t C>
+constexpr FixedMatrix<T, R, C> operator-(const FixedMatrix<T, R, C>& x) {
+    FixedMatrix<T, R, C> ret;
+    T* r = ret.data();
+    SJTU_UNROLL for (size_t k = 0; k < R * C; k++)
+        r[k] = -x.coeff(k);
+    return ret;
+}
+
+template <class T,
+          size_t R,
+          size_t C,
+          class U,
+          class = typename std::enable_if<!IsMatrixExpr<U>::value>::type>
+constexpr auto operator*(const FixedMatrix<T, R, C>& x, const U& s)
+    -> FixedMatrix<decltype(T() * U()), R, C> {
+    FixedMatrix<decltype(T() * U()), R, C> ret;
+    auto* r = ret.data();
+    SJTU_UNROLL for (size_t k = 0; k < R * C; k++)
+        r[k] = x.coeff(k) * s;
+    return ret;
+}
+
+template <class T,
+          size_t R,
+          size_t C,
+          class U,
+          class = typename std::enable_if<!IsMatrixExpr<U>::value>::type>
+constexpr auto operator*(const U& s, const FixedMatrix<T, R, C>& x)
+    -> FixedMatrix<decltype(T() * U()), R, C> {
+    return x * s;
+}
+
+// an unrolled i-k-j product; the inner dimensions must agree at compile time
+template <class T, class U, size_t R, size_t K, size_t K2, size_t N>
+constexpr auto operator*(const FixedMatrix<T, R, K>& x,
+                         const FixedMatrix<U, K2, N>& y)
+    -> FixedMatrix<decltype(T() * U()), R, N> {
+    static_assert(K == K2, "multiplication between invalid matrices");
+    typedef decltype(T() * U()) W;
+    FixedMatrix<W, R, N> ret;
+    W* r = ret.data();
+    SJTU_UNROLL for (size_t i = 0; i < R; i++)
+        SJTU_UNROLL for (size_t k = 0; k < K; k++) {
+            const W aik = x.coeff(i, k);
+            SJTU_UNROLL for (size_t j = 0; j < N; j++)
+                r[i * N + j] += aik * y.coeff(k, j);
+        }
+    return ret;
+}
+
+// one entry of a sparse matrix under construction
+template <class T>
+struct Triplet {
+    size_t row, col;
+    T value;
+};
+
+namespace detail {
+/**
+ * The storage behind CsrMatrix and CscMatrix: outer slices (rows of a CSR
+ * matrix, columns of a CSC one), each a run of nonzeros in ascending inner
+ * index. Slice o is [ptr[o], ptr[o + 1]) of idx and val. The CSC storage
+ * of a matrix is the CSR storage of its transpose.
+ */
+template <class T, class Index>
+struct Compressed {
+    size_t outer, inner;
+    Vector<Index> ptr, idx;
+    Vector<T> val;
+
+    Compressed(size_t o = 0, size_t i = 0) : outer(o), inner(i) {
+        fits(max(o, i));
+        ptr.assign(o + 1, Index(0));
+    }
+
+    static void fits(size_t n) {
+        if (n > size_t(std::numeric_limits<Index>::max()))
+            throw std::invalid_argument("too large for the index type");
+    }
+
+    size_t nonZeros() const { return size_t(ptr[outer]); }
+
+    T at(size_t o, size_t i) const {
+        const Index* first = idx.data() + size_t(ptr[o]);
+        const Index* last = idx.data() + size_t(ptr[o + 1]);
+        const Index* p = std::lower_bound(first, last, Index(i));
+        return p != last && size_t(*p) == i ? val[p - idx.data()] : T(0);
+    }
+
+    /**
+     * From n entries (outer, inner, value) = get(k), in any order;
+     * duplicates are summed. Two stable counting sorts, by inner and then
+     * by outer index, leave them in order in linear time.
+     */
+    template <class F>
+    static Compressed fromEntries(size_t outer,
+                                  size_t inner,
+                                  size_t n,
+                                  const F& get) {
+        fits(n);
+        std::vector<size_t> count(max(outer, inner) + 1), byInner(n),
+            order(n);
+        for (size_t k = 0; k < n; k++)
+            count[get(k).inner + 1]++;
+        for (size_t i = 0; i < inner; i++)
+            count[i + 1] += count[i];
+        for (size_t k = 0; k < n; k++)
+            byInner[count[get(k).inner]++] = k;
+        std::fill(count.begin(), count.end(), size_t(0));
+        for (size_t k = 0; k < n; k++)
+            count[get(k).outer + 1]++;
+        for (size_t o = 0; o < outer; o++)
+            count[o + 1] += count[o];
+        for (size_t k : byInner)
+            order[count[get(k).outer]++] = k;
+
+        Compressed c(outer, inner);
+        c.idx.assign(n, Index(0));
+        c.val.assign(n, T(0));
+        size_t nz = 0, k = 0;
+        for (size_t o = 0; o < outer; o++) {
+            const size_t slice = nz;
+            for (; k < n && get(order[k]).outer == o; k++) {
+                const auto e = get(order[k]);
+                if (nz > slice && size_t(c.idx[nz - 1]) == e.inner) {
+                    c.val[nz - 1] += e.value;
+                } else {
+                    c.idx[nz] = Index(e.inner);
+                    c.val[nz++] = e.value;
+                }
+            }
+            c.ptr[o + 1] = Index(nz);
+        }
+        c.idx.resize(nz);
+        c.val.resize(nz);
+        return c;
+    }
+
+    // the nonzeros of e, by rows when byRow is set and by columns if not
+    template <class E>
+    static Compressed fromDense(const E& e, bool byRow) {
+        typedef typename E::value_type U;
+        const size_t o = byRow ? e.rowLength() : e.columnLength();
+        const size_t in = byRow ? e.columnLength() : e.rowLength();
+        auto get = [&](size_t s, size_t t) -> const U& {
+            return byRow ? e.coeff(s, t) : e.coeff(t, s);
+        };
+        Compressed c(o, in);
+        rowwise<T>(o, in, [&](size_t s) {
+            size_t n = 0;
+            for (size_t t = 0; t < in; t++)
+                n += get(s, t) != U(0);
+            c.ptr[s + 1] = Index(n);
+        });
+        size_t nnz = 0;
+        for (size_t s = 0; s < o; s++) {
+            nnz += size_t(c.ptr[s + 1]);
+            fits(nnz);
+            c.ptr[s + 1] = Index(nnz);
+        }
+        c.idx.assign(nnz, Index(0));
+        c.val.assign(nnz, T(0));
+        rowwise<T>(o, in, [&](size_t s) {
+            size_t p = size_t(c.ptr[s]);
+            for (size_t t = 0; t < in; t++)
+                if (get(s, t) != U(0)) {
+                    c.idx[p] = Index(t);
+                    c.val[p++] = T(get(s, t));
+                }
+        });
+        return c;
+    }
+
+    // the same matrix compressed the other way, by a counting sort
+    Compressed transposed() const {
+        Compressed t(inner, outer);
+        const size_t nnz = nonZeros();
+        t.idx.assign(nnz, Index(0));
+        t.val.assign(nnz, T(0));
+        for (size_t p = 0; p < nnz; p++)
+            t.ptr[size_t(idx[p]) + 1]++;
+        for (size_t i = 0; i < inner; i++)
+            t.ptr[i + 1] += t.ptr[i];
+        Vector<Index> next(t.ptr);
+        for (size_t o = 0; o < outer; o++)
+            for (size_t p = size_t(ptr[o]); p < size_t(ptr[o + 1]); p++) {
+                const size_t q = size_t(next[size_t(idx[p])]++);
+                t.idx[q] = Index(o);
+                t.val[q] = val[p];
+            }
+        return t;
+    }
+
+    // dst = this as a dense matrix, byRow as in fromDense()
+    template <class U>
+    void scatterTo(const MatrixView<U>& dst, bool byRow) const {
+        rowwise<U>(dst.rowLength(), dst.columnLength(), [&](size_t i) {
+            for (size_t j = 0; j < dst.columnLength(); j++)
+                dst.coeff(i, j) = U(0);
+        });
+        rowwise<T>(outer, inner, [&](size_t o) {
+            for (size_t p = size_t(ptr[o]); p < size_t(ptr[o + 1]); p++) {
+                const size_t i = size_t(idx[p]);
+                (byRow ? dst.coeff(o, i) : dst.coeff(i, o)) = U(val[p]);
+            }
+        });
+    }
+
+    /**
+     * f(lo, hi) over ranges of outer slices holding about equal shares of
+     * the nonzeros, on the pool when the work, nonzeros times width, is
+     * big enough to split.
+     */
+    template <class W, class F>
+    void balanced(size_t width, size_t parts, const F& f) const {
+        const size_t nnz = nonZeros();
+        size_t chunks = 1;
+        if (std::is_arithmetic<W>::value &&
+            (nnz + outer) * max(width, size_t(1)) >= 2 * ELEMENTWISE_GRAIN)
+            chunks = min(outer, parts);
+        if (chunks <= 1) {
+            f(size_t(0), outer, size_t(0));
+            return;
+        }
+        std::vector<size_t> cut(chunks + 1, outer);
+        cut[0] = 0;
+        for (size_t t = 1; t < chunks; t++) {
+            const Index share = Index(nnz / chunks * t);
+            cut[t] = std::lower_bound(ptr.data(), ptr.data() + outer + 1,
+                                      share) -
+                     ptr.data();
+            cut[t] = min(max(cut[t], cut[t - 1]), outer);
+        }
+        ThreadPool::global().parallelFor(chunks, [&](size_t t) {
+            if (cut[t] < cut[t + 1])
+                f(cut[t], cut[t + 1], t);
+        });
+    }
+};
+
+/**
+ * c = a * b for a CSR a: row i of c gathers the rows of b that the
+ * nonzeros of row i of a select, so threads own disjoint rows of c.
+ */
+template <class W, class T, class I, class B>
+void csrProduct(const MatrixView<W>& c, const Compressed<T, I>& a, const B& b) {
+    const size_t N = c.columnLength();
+    const bool rows = b.colStride() == 1 && c.colStride() == 1;
+    a.template balanced<W>(N, ThreadPool::global().size() * 4,
+                           [&](size_t lo, size_t hi, size_t) {
+        for (size_t i = lo; i < hi; i++) {
+            const size_t p0 = size_t(a.ptr[i]), p1 = size_t(a.ptr[i + 1]);
+            if (N == 1) {
+                W s = W(0);
+                for (size_t p = p0; p < p1; p++)
+                    s += a.val[p] * b.coeff(size_t(a.idx[p]), 0);
+                c.coeff(i, 0) = s;
+                continue;
+            }
+            for (size_t j = 0; j < N; j++)
+                c.coeff(i, j) = W(0);
+            for (size_t p = p0; p < p1; p++) {
+                const T v = a.val[p];
+                const size_t k = size_t(a.idx[p]);
+                if (rows) {
+                    W* ci = c.data() + i * c.rowStride();
+                    const auto* bk = b.data() + k * b.rowStride();
+                    for (size_t j = 0; j < N; j++)
+                        ci[j] += v * bk[j];
+                } else {
+                    for (size_t j = 0; j < N; j++)
+                        c.coeff(i, j) += v * b.coeff(k, j);
+                }
+            }
+        }
+    });
+}
+
+/**
+ * c = a * b for a CSC a: column k of a scatters row k of b into the rows
+ * of c. With enough columns threads split the columns of c; otherwise
+ * (e.g. a vector b) a is recompressed by rows, in O(nnz) time and space,
+ * and goes through csrProduct(), where threads own disjoint rows of c.
+ */
+template <class W, class T, class I, class B>
+void cscProduct(const MatrixView<W>& c, const Compressed<T, I>& a, const B& b) {
+    const size_t M = c.rowLength(), N = c.columnLength();
+    const size_t threads = ThreadPool::global().size();
+    auto scatter = [&](size_t lo, size_t hi, size_t j0, size_t j1,
+                       const MatrixView<W>& dst) {
+        for (size_t k = lo; k < hi; k++)
+            for (size_t p = size_t(a.ptr[k]); p < size_t(a.ptr[k + 1]); p++) {
+                const T v = a.val[p];
+                const size_t i = size_t(a.idx[p]);
+                for (size_t j = j0; j < j1; j++)
+                    dst.coeff(i, j) += v * b.coeff(k, j);
+            }
+    };
+    const size_t work = (a.nonZeros() + a.outer) * N;
+    const bool serial = !std::is_arithmetic<W>::value || threads == 1 ||
+                        work < 2 * ELEMENTWISE_GRAIN;
+    if (!serial && N < threads) {
+        csrProduct(c, a.transposed(), b);
+        return;
+    }
+    rowwise<W>(M, N, [&](size_t i) {
+        for (size_t j = 0; j < N; j++)
+            c.coeff(i, j) = W(0);
+    });
+    if (serial) {
+        scatter(0, a.outer, 0, N, c);
+    } else {
+        parallelChunks(N, (N + threads - 1) / threads,
+                       [&](size_t j0, size_t j1) {
+                           scatter(0, a.outer, j0, j1, c);
+                       });
+    }
+}
+
+// the product of a sparse a (compressed by rows if byRow) and dense b
+template <class W, class T, class I, class E>
+void sparseProduct(const MatrixView<W>& c,
+                   const Compressed<T, I>& a,
+                   bool byRow,
+                   const E& b) {
+    if (b.aliases(c, false)) {
+        Matrix<W> tmp(c.rowLength(), c.columnLength());
+        sparseProduct(tmp.view(), a, byRow, b);
+        c = tmp;
+        return;
+    }
+    const auto& bd = materialize(b);
+    if (byRow)
+        csrProduct(c, a, bd);
+    else
+        cscProduct(c, a, bd);
+}
+}  // namespace detail
+
+/**
+ * A sparse matrix in compressed sparse row form: for each row, its
+ * nonzero columns in ascending order and their values. Index is the type
+ * of the stored column indices and row offsets; a narrower one than
+ * size_t saves memory when it can count every nonzero.
+ */
+template <class T, class Index>
+class CsrMatrix {
+    template <class U, class I>
+    friend class CscMatrix;
+
+   private:
+    detail::Compressed<T, Index> s;
+
+    explicit CsrMatrix(detail::Compressed<T, Index>&& c) : s(std::move(c)) {}
+
+   public:
+    typedef T value_type;
+    typedef Index index_type;
+
+    CsrMatrix() {}
+
+    // a rows x cols matrix of zeros
+    CsrMatrix(size_t rows, size_t cols) : s(rows, cols) {}
+
+    // the nonzeros of a dense matrix or expression
+    template <class E>
+    explicit CsrMatrix(const MatrixExpr<E>& e)
+        : s(detail::Compressed<T, Index>::fromDense(e.self(), true)) {}
+
+    // from entries in any order, summing duplicates
+    CsrMatrix(size_t rows, size_t cols, const std::vector<Triplet<T>>& t) {
+        struct Entry {
+            size_t outer, inner;
+            const T& value;
+        };
+        for (const Triplet<T>& e : t)
+            if (e.row >= rows || e.col >= cols)
+                throw std::invalid_argument("out of range");
+        s = detail::Compressed<T, Index>::fromEntries(
+            rows, cols, t.size(), [&](size_t k) {
+                return Entry{t[k].row, t[k].col, t[k].value};
+            });
+    }
+
+    explicit CsrMatrix(const CscMatrix<T, Index>& o)
+        : s(o.s.transposed()) {}
+
+    size_t rowLength() const { return s.outer; }
+    size_t columnLength() const { return s.inner; }
+    std::pair<size_t, size_t> size() const {
+        return std::make_pair(s.outer, s.inner);
+    }
+    size_t nonZeros() const { return s.nonZeros(); }
+
+    // element (i, j), zero when not stored; a binary search in row i
+    T operator()(size_t i, size_t j) const {
+        detail::checkIndex(i < s.outer && j < s.inner);
+        return s.at(i, j);
+    }
+
+    // row i is [rowPointers()[i], rowPointers()[i + 1]) of the arrays below
+    const Index* rowPointers() const { return s.ptr.data(); }
+    const Index* columnIndices() const { return s.idx.data(); }
+    const T* values() const { return s.val.data(); }
+    T* values() { return s.val.data(); }
+
+    Matrix<T> toDense() const {
+        Matrix<T> ret(s.outer, s.inner);
+        s.scatterTo(ret.view(), true);
+        return ret;
+    }
+
+    CscMatrix<T, Index> toCsc() const { return CscMatrix<T, Index>(*this); }
+
+    CsrMatrix tran() const { return CsrMatrix(s.transposed()); }
+
+    template <class W, class E>
+    void productTo(const MatrixView<W>& c, const E& b) const {
+        detail::sparseProduct(c, s, true, b);
+    }
+};
+
+/**
+ * A sparse matrix in compressed sparse column form, the mirror image of
+ * CsrMatrix: for each column, its nonzero rows in ascending order.
+ */
+template <class T, class Index>
+class CscMatrix {
+    template <class U, class I>
+    friend class CsrMatrix;
+
+   private:
+    detail::Compressed<T, Index> s;
+
+    explicit CscMatrix(detail::Compressed<T, Index>&& c) : s(std::move(c)) {}
+
+   public:
+    typedef T value_type;
+    typedef Index index_type;
+
+    CscMatrix() {}
+
+    CscMatrix(size_t rows, size_t cols) : s(cols, rows) {}
+
+    template <class E>
+    explicit CscMatrix(const MatrixExpr<E>& e)
+        : s(detail::Compressed<T, Index>::fromDense(e.self(), false)) {}
+
+    CscMatrix(size_t rows, size_t cols, const std::vector<Triplet<T>>& t) {
+        struct Entry {
+            size_t outer, inner;
+            const T& value;
+        };
+        for (const Triplet<T>& e : t)
+            if (e.row >= rows || e.col >= cols)
+                throw std::invalid_argument("out of range");
+        s = detail::Compressed<T, Index>::fromEntries(
+            cols, rows, t.size(), [&](size_t k) {
+                return Entry{t[k].col, t[k].row, t[k].value};
+            });
+    }
+
+    explicit CscMatrix(const CsrMatrix<T, Index>& o)
+        : s(o.s.transposed()) {}
+
+    size_t rowLength() const { return s.inner; }
+    size_t columnLength() const { return s.outer; }
+    std::pair<size_t, size_t> size() const {
+        return std::make_pair(s.inner, s.outer);
+    }
+    size_t nonZeros() const { return s.nonZeros(); }
+
+    T operator()(size_t i, size_t j) const {
+        detail::checkIndex(i < s.inner && j < s.outer);
+        return s.at(j, i);
+    }
+
+    // column j is [columnPointers()[j], columnPointers()[j + 1])
+    const Index* columnPointers() const { return s.ptr.data(); }
+    const Index* rowIndices() const { return s.idx.data(); }
+    const T* values() const { return s.val.data(); }
+    T* values() { return s.val.data(); }
+
+    Matrix<T> toDense() const {
+        Matrix<T> ret(s.inner, s.outer);
+        s.scatterTo(ret.view(), false);
+        return ret;
+    }
+
+    CsrMatrix<T, Index> toCsr() const { return CsrMatrix<T, Index>(*this); }
+
+    CscMatrix tran() const { return CscMatrix(s.transposed()); }
+
+    template <class W, class E>
+    void productTo(const MatrixView<W>& c, const E& b) const {
+        detail::sparseProduct(c, s, false, b);
+    }
+};
+
+// sparse a times a dense matrix, view, expression or column vector b
+template <class S,
+          class E,
+          class = typename std::enable_if<IsSparse<S>::value>::type>
+auto operator*(const S& a, const MatrixExpr<E>& b)
+    -> Matrix<decltype(typename S::value_type() *
+                       typename E::value_type())> {
+    using W = decltype(typename S::value_type() * typename E::value_type());
+    if (a.columnLength() != b.self().rowLength()) {
+        throw std::invalid_argument("multiplication between invalid matrices");
+    }
+    Matrix<W> ret(a.rowLength(), b.self().columnLength());
+    a.productTo(ret.view(), b.self());
+    return ret;
+}
+
+// dst = a * b for a sparse a, writing into a Matrix (resized if needed) or
+// a MatrixView
+template <class D,
+          class S,
+          class E,
+          class = typename std::enable_if<IsSparse<S>::value>::type>
+void multiply(D&& dst, const S& a, const MatrixExpr<E>& b) {
+    typedef typename detail::ExprType<D>::value_type T;
+    if (a.columnLength() != b.self().rowLength()) {
+        throw std::invalid_argument("multiplication between invalid matrices");
+    }
+    if constexpr (IsMatrix<detail::ExprType<D>>::value) {
+        if (dst.rowLength() != a.rowLength() ||
+            dst.columnLength() != b.self().columnLength())
+            dst.resize(a.rowLength(), b.self().columnLength());
+    }
+    const MatrixView<T> c = dst.view();
+    if (c.rowLength() != a.rowLength() ||
+        c.columnLength() != b.self().columnLength()) {
+        throw std::invalid_argument("multiplication between invalid matrices");
+    }
+    a.productTo(c, b.self());
+}
+
+namespace detail {
+// elements are factored in double when they are integers, as-is otherwise
+template <class T>
+using FieldType =
+    typename std::conditional<std::is_integral<T>::value, double, T>::type;
+
+// the size of a pivot candidate; any nonzero will do for exact types
+template <class T>
+double magnitude(const T& x) {
+    if constexpr (std::is_arithmetic<T>::value)
+        return x < T(0) ? -double(x) : double(x);
+    else
+        return x == T(0) ? 0.0 : 1.0;
+}
+
+// y -= alpha * x over n elements
+template <class T>
+void axpyRow(T* y, const T* x, const T& alpha, size_t n) {
+    for (size_t j = 0; j < n; j++)
+        y[j] -= alpha * x[j];
+}
+
+// c -= a * b through the packed GEMM, negating the thinner operand
+template <class T>
+void gemmSubtract(const MatrixView<T>& c,
+                  const MatrixView<const T>& a,
+                  const MatrixView<const T>& b) {
+    if (c.rowLength() == 0 || c.columnLength() == 0 || a.columnLength() == 0)
+        return;
+    if (a.rowLength() <= b.columnLength()) {
+        const Matrix<T> na = -a;
+        gemmInto(c, na.view(), b);
+    } else {
+        const Matrix<T> nb = -b;
+        gemmInto(c, a, nb.view());
+    }
+}
+
+// the panel width of the blocked factorizations
+const size_t FACTOR_BLOCK = 64;
+
+// x = U^-1 x for the upper triangle of the n x n u, blocked like the
+// factorizations so that the off-diagonal work runs in GEMM
+template <class T>
+void solveUpper(const T* u, size_t ldu, Matrix<T>& x) {
+    const size_t n = x.rowLength(), m = x.columnLength(), NB = FACTOR_BLOCK;
+    T* px = x.data();
+    for (size_t i1 = n; i1 > 0;) {
+        const size_t i0 = (i1 - 1) / NB * NB;
+        for (size_t i = i1; i-- > i0;) {
+            for (size_t l = i + 1; l < i1; l++)
+                axpyRow(px + i * m, px + l * m, u[i * ldu + l], m);
+            for (size_t j = 0; j < m; j++)
+                px[i * m + j] /= u[i * ldu + i];
+        }
+        gemmSubtract(x.block(0, 0, i0, m),
+                     MatrixView<const T>(u + i0, i0, i1 - i0, ldu),
+                     MatrixView<const T>(px + i0 * m, i1 - i0, m, m));
+        i1 = i0;
+    }
+}
+}  // namespace detail
+
+/**
+ * PA = LU with partial pivoting, for a square A. The factorization is
+ * right-looking and blocked as in LAPACK's getrf: each panel of
+ * FACTOR_BLOCK columns is factored on its own, the block row to its right
+ * is solved against it, and the trailing matrix is updated by one GEMM,
+ * which is where almost all the work goes. Once built, it solves any
+ * number of right-hand sides.
+ *
+ * A singular A still factors; solve() and inverse() then throw.
+ */
+template <class T>
+class LU {
+   private:
+    Matrix<T> lu;
+    std::vector<size_t> perm;
+    bool oddSwaps, isSingular;
+
+    MatrixView<const T> blockOf(size_t i, size_t j, size_t r, size_t c) const {
+        return lu.block(i, j, r, c);
+    }
+
+    void factor() {
+        const size_t n = lu.rowLength(), NB = detail::FACTOR_BLOCK;
+        T* a = lu.data();
+        for (size_t k0 = 0; k0 < n; k0 += NB) {
+            const size_t k1 = min(n, k0 + NB);
+            // the panel, unblocked; its row swaps move whole rows
+            for (size_t j = k0; j < k1; j++) {
+                size_t p = j;
+                for (size_t i = j + 1; i < n; i++)
+                    if (detail::magnitude(a[i * n + j]) >
+                        detail::magnitude(a[p * n + j]))
+                        p = i;
+                if (p != j) {
+                    std::swap_ranges(a + j * n, a + (j + 1) * n, a + p * n);
+                    swap(perm[j], perm[p]);
+                    oddSwaps = !oddSwaps;
+                }
+                const T pivot = a[j * n + j];
+                if (pivot == T(0)) {
+                    isSingular = true;
+                    continue;
+                }
+                for (size_t i = j + 1; i < n; i++) {
+                    T& l = a[i * n + j];
+                    l /= pivot;
+                    detail::axpyRow(a + i * n + j + 1, a + j * n + j + 1, l,
+                                    k1 - j - 1);
+                }
+            }
+            if (k1 == n)
+                break;
+            // U12 = L11^-1 A12, split by columns between threads
+            detail::parallelChunks(
+                n - k1, max(size_t(64), detail::ELEMENTWISE_GRAIN / NB / NB),
+                [&](size_t lo, size_t hi) {
+                    for (size_t i = k0 + 1; i < k1; i++)
+                        for (size_t l = k0; l < i; l++)
+                            detail::axpyRow(a + i * n + k1 + lo,
+                                            a + l * n + k1 + lo,
+                                            a[i * n + l], hi - lo);
+                });
+            // A22 -= L21 U12
+            detail::gemmSubtract(lu.block(k1, k1, n - k1, n - k1),
+                                 blockOf(k1, k0, n - k1, k1 - k0),
+                                 blockOf(k0, k1, k1 - k0, n - k1));
+        }
+    }
+
+   public:
+    typedef T value_type;
+
+    template <class E>
+    explicit LU(const MatrixExpr<E>& a)
+        : lu(a.self()), oddSwaps(false), isSingular(false) {
+        if (lu.rowLength() != lu.columnLength()) {
+            throw std::invalid_argument("LU of a non-square matrix");
+        }
+        SJTU_COUNT_OP(stats::LU, lu.Size(),
+                      2.0 / 3 * lu.Size() * lu.rowLength());
+        perm.resize(lu.rowLength());
+        for (size_t i = 0; i < perm.size(); i++)
+            perm[i] = i;
+        factor();
+    }
+
+    size_t size() const { return lu.rowLength(); }
+
+    bool singular() const { return isSingular; }
+
+    // L strictly below the diagonal (its unit diagonal implied), U on and
+    // above it
+    const Matrix<T>& packed() const { return lu; }
+
+    // row i of PA is row permutation()[i] of A
+    const std::vector<size_t>& permutation() const { return perm; }
+
+    T determinant() const {
+        T det = T(1);
+        for (size_t i = 0; i < size(); i++)
+            det *= lu.coeff(i, i);
+        return oddSwaps ? -det : det;
+    }
+
+    /**
+     * X with AX = B, for every column of B at once: the permuted B goes
+     * through blocked forward and back substitution, the off-diagonal
+     * blocks again as GEMM updates.
+     */
+    template <class E>
+    Matrix<T> solve(const MatrixExpr<E>& rhs) const {
+        const auto& b = detail::materialize(rhs.self());
+        const size_t n = size(), m = b.columnLength();
+        const size_t NB = detail::FACTOR_BLOCK;
+        if (b.rowLength() != n) {
+            throw std::invalid_argument("invalid right-hand side");
+        }
+        if (isSingular) {
+            throw std::invalid_argument("solve with a singular matrix");
+        }
+        Matrix<T> x(n, m);
+        for (size_t i = 0; i < n; i++)
+            x.rowView(i) = b.rowView(perm[i]);
+        T* px = x.data();
+        const T* a = lu.data();
+        const auto solved = [&](size_t i0, size_t i1) {
+            return MatrixView<const T>(px + i0 * m, i1 - i0, m, m);
+        };
+        // L y = P b
+        for (size_t i0 = 0; i0 < n; i0 += NB) {
+            const size_t i1 = min(n, i0 + NB);
+            for (size_t i = i0 + 1; i < i1; i++)
+                for (size_t l = i0; l < i; l++)
+                    detail::axpyRow(px + i * m, px + l * m, a[i * n + l], m);
+            detail::gemmSubtract(x.block(i1, 0, n - i1, m),
+                                 blockOf(i1, i0, n - i1, i1 - i0),
+                                 solved(i0, i1));
+        }
+        // U x = y
+        detail::solveUpper(a, n, x);
+        return x;
+    }
+
+    Matrix<T> inverse() const {
+        Matrix<T> id(size(), size(), T(0));
+        for (size_t i = 0; i < size(); i++)
+            id.data()[i * size() + i] = T(1);
+        return solve(id);
+    }
+};
+
+// x with ax = b, by an LU factorization of a; integers are solved in double
+template <class E, class F>
+Matrix<detail::FieldType<typename E::value_type>> solve(
+    const MatrixExpr<E>& a,
+    const MatrixExpr<F>& b) {
+    return LU<detail::FieldType<typename E::value_type>>(a).solve(b);
+}
+
+template <class E>
+detail::FieldType<typename E::value_type> determinant(const MatrixExpr<E>& a) {
+    return LU<detail::FieldType<typename E::value_type>>(a).determinant();
+}
+
+template <class E>
+Matrix<detail::FieldType<typename E::value_type>> inverse(
+    const MatrixExpr<E>& a) {
+    return LU<detail::FieldType<typename E::value_type>>(a).inverse();
+}
+
+namespace detail {
+// TSQR is picked by itself from this many rows per column on
+const size_t TSQR_MIN_RATIO = 8;
+
+// the size of a TSQR row block, about what L2 holds
+const size_t TSQR_BLOCK_BYTES = size_t(1) << 20;
+
+// the width below which panels are factored column by column
+const size_t PANEL_LEAF = 8;
+
+/**
+ * Householder QR in place, as LAPACK's geqrf: the reflectors
+ * H_j = I - tau_j v_j v_j^T sit below the diagonal with their unit leading
+ * entries implied, R on and above it. Each FACTOR_BLOCK-wide panel keeps
+ * the triangular factor of its compact WY form H_k0 ... H_k1-1 = I - V T V^T,
+ * so applying the panel to anything is two GEMMs around a small product.
+ */
+template <class T>
+class Householder {
+   private:
+    Matrix<T> qr;
+    std::vector<T> tau;
+    std::vector<Matrix<T>> ts;
+
+    // the explicit V of the panel starting at column k0
+    Matrix<T> panel(size_t k0, size_t kb) const {
+        const size_t m = qr.rowLength() - k0, n = qr.columnLength();
+        const T* a = qr.data() + k0 * n + k0;
+        Matrix<T> v(m, kb, T(0));
+        for (size_t i = 0; i < m; i++)
+            for (size_t j = 0; j < kb && j <= i; j++)
+                v.data()[i * kb + j] = i == j ? T(1) : a[i * n + j];
+        return v;
+    }
+
+    // c -= V T V^T c, or with T^T when transposed
+    static void reflect(const MatrixView<T>& c,
+                        const Matrix<T>& v,
+                        const Matrix<T>& t,
+                        bool transposed) {
+        const size_t kb = v.columnLength(), k = c.columnLength();
+        Matrix<T> w(kb, k, T(0)), tw(kb, k, T(0));
+        gemmInto(w.view(),
+                 MatrixView<const T>(v.data(), kb, v.rowLength(), 1, kb), c);
+        gemmInto(tw.view(),
+                 transposed ? MatrixView<const T>(t.data(), kb, kb, 1, kb)
+                            : MatrixView<const T>(t.view()),
+                 MatrixView<const T>(w.view()));
+        gemmSubtract(c, MatrixView<const T>(v.view()),
+                     MatrixView<const T>(tw.view()));
+    }
+
+    // the triangular T of the compact WY form of v, by columns from the
+    // Gram matrix of v, as larft does
+    Matrix<T> triangular(const Matrix<T>& v, size_t k0) const {
+        const size_t kb = v.columnLength();
+        Matrix<T> g(kb, kb, T(0)), t(kb, kb, T(0));
+        gemmInto(g.view(),
+                 MatrixView<const T>(v.data(), kb, v.rowLength(), 1, kb),
+                 MatrixView<const T>(v.view()));
+        for (size_t i = 0; i < kb; i++) {
+            const T ti = tau[k0 + i];
+            t.data()[i * kb + i] = ti;
+            for (size_t l = 0; l < i; l++) {
+                T s = T(0);
+                for (size_t p = l; p < i; p++)
+                    s += t.data()[l * kb + p] * g.data()[p * kb + i];
+                t.data()[l * kb + i] = -ti * s;
+            }
+        }
+        return t;
+    }
+
+    // columns k0..k1 one reflector at a time
+    void factorLeaf(size_t k0, size_t k1) {
+        const size_t m = qr.rowLength(), n = qr.columnLength();
+        T* a = qr.data();
+        T w[PANEL_LEAF];
+        for (size_t j = k0; j < k1; j++) {
+            const T alpha = a[j * n + j];
+            T sigma = T(0);
+            for (size_t i = j + 1; i < m; i++)
+                sigma += a[i * n + j] * a[i * n + j];
+            if (sigma == T(0))
+                continue;
+            T beta = std::sqrt(alpha * alpha + sigma);
+            if (alpha > T(0))
+                beta = -beta;
+            tau[j] = (beta - alpha) / beta;
+            const T scale = T(1) / (alpha - beta);
+            a[j * n + j] = beta;
+            // v scaled and w = v^T A over the rest, in one pass
+            const size_t rest = k1 - j - 1;
+            T* top = a + j * n + j + 1;
+            std::copy(top, top + rest, w);
+            for (size_t i = j + 1; i < m; i++) {
+                a[i * n + j] *= scale;
+                axpyRow(w, a + i * n + j + 1, -a[i * n + j], rest);
+            }
+            for (size_t c = 0; c < rest; c++)
+                w[c] *= tau[j];
+            // A -= tau v w
+            axpyRow(top, w, T(1), rest);
+            for (size_t i = j + 1; i < m; i++)
+                axpyRow(a + i * n + j + 1, w, a[i * n + j], rest);
+        }
+    }
+
+    // columns k0..k1 recursively: the left half's reflectors reach the
+    // right half as one block, so a tall panel is streamed a few times
+    // rather than twice per column
+    void factorPanel(size_t k0, size_t k1) {
+        if (k1 - k0 <= PANEL_LEAF) {
+            factorLeaf(k0, k1);
+            return;
+        }
+        const size_t m = qr.rowLength(), mid = k0 + (k1 - k0) / 2;
+        factorPanel(k0, mid);
+        const Matrix<T> v = panel(k0, mid - k0);
+        reflect(qr.block(k0, mid, m - k0, k1 - mid), v, triangular(v, k0),
+                true);
+        factorPanel(mid, k1);
+    }
+
+    void factor() {
+        const size_t m = qr.rowLength(), n = qr.columnLength();
+        const size_t r = min(m, n), NB = FACTOR_BLOCK;
+        tau.assign(r, T(0));
+        for (size_t k0 = 0; k0 < r; k0 += NB) {
+            const size_t k1 = min(r, k0 + NB);
+            factorPanel(k0, k1);
+            const Matrix<T> v = panel(k0, k1 - k0);
+            Matrix<T> t = triangular(v, k0);
+            if (k1 < n)
+                reflect(qr.block(k0, k1, m - k0, n - k1), v, t, true);
+            ts.push_back(std::move(t));
+        }
+    }
+
+   public:
+    Householder() = default;
+
+    explicit Householder(Matrix<T> a) : qr(std::move(a)) { factor(); }
+
+    size_t rowLength() const { return qr.rowLength(); }
+
+    size_t columnLength() const { return qr.columnLength(); }
+
+    const Matrix<T>& packed() const { return qr; }
+
+    // the leading min(m, n) rows of Q^T c
+    Matrix<T> reduce(Matrix<T> c) const {
+        const size_t m = rowLength(), r = min(m, columnLength());
+        for (size_t p = 0; p < ts.size(); p++) {
+            const size_t k0 = p * FACTOR_BLOCK, kb = ts[p].rowLength();
+            reflect(c.block(k0, 0, m - k0, c.columnLength()), panel(k0, kb),
+                    ts[p], true);
+        }
+        if (r == m)
+            return c;
+        return Matrix<T>(c.block(0, 0, r, c.columnLength()));
+    }
+
+    // Q times head stacked on zeros
+    template <class E>
+    Matrix<T> expand(const MatrixExpr<E>& head) const {
+        const size_t m = rowLength(), k = head.self().columnLength();
+        Matrix<T> c(m, k, T(0));
+        c.block(0, 0, head.self().rowLength(), k) = head.self();
+        for (size_t p = ts.size(); p-- > 0;) {
+            const size_t k0 = p * FACTOR_BLOCK, kb = ts[p].rowLength();
+            reflect(c.block(k0, 0, m - k0, k), panel(k0, kb), ts[p], false);
+        }
+        return c;
+    }
+
+    Matrix<T> R() const {
+        const size_t n = columnLength(), r = min(rowLength(), n);
+        Matrix<T> ret(r, n, T(0));
+        for (size_t i = 0; i < r; i++)
+            for (size_t j = i; j < n; j++)
+                ret.data()[i * n + j] = qr.data()[i * n + j];
+        return ret;
     }
+};
+}  // namespace detail
 
-    size_t Size() const { return R * C; }
+enum class QrMode { AUTO, BLOCKED, TSQR };
 
-    void resize(size_t _n, size_t _m, T _init = T()) {
-        Data.resize(_n * _m, _init);
-        R = _n, C = _m;
-    }
+/**
+ * A = QR by blocked Householder reflections, for least squares on tall A.
+ *
+ * In TSQR mode the rows are split into blocks of about TSQR_BLOCK_BYTES,
+ * factored independently and in parallel, and their stacked R factors are
+ * reduced the same way until one block is left. Every block is factored
+ * in cache, so a tall-skinny A costs a single streaming pass instead of a
+ * pass per column, and Q stays a tree of small factors that is never
+ * formed unless asked for. AUTO picks it for A with at least
+ * TSQR_MIN_RATIO rows per column that does not fit in a couple of blocks.
+ */
+template <class T>
+class QR {
+    static_assert(std::is_floating_point<T>::value,
+                  "QR needs floating-point elements");
 
-    void resize(std::pair<size_t, size_t> sz, T _init = T()) {
-        Data.resize(sz.first * sz.second, _init);
-        R = sz.first, C = sz.second;
-    }
+   private:
+    // one round of TSQR: the row block boundaries and their factors
+    struct Level {
+        std::vector<size_t> offsets;
+        std::vector<detail::Householder<T>> blocks;
+    };
 
-    std::pair<size_t, size_t> size() const { return std::make_pair(R, C); };
+    std::vector<Level> levels;
+    detail::Householder<T> top;
+    size_t m, n;
 
-    void clear() {
-        R = 0, C = 0;
-        Data.clear();
+    // how many blocks to split rows into, 1 to stop
+    size_t parts(size_t rows) const {
+        const size_t blockRows =
+            max(size_t(1), detail::TSQR_BLOCK_BYTES / sizeof(T) / n);
+        const size_t wanted = max(ThreadPool::global().size(),
+                                  (rows + blockRows - 1) / blockRows);
+        return min(rows / (2 * n), max(size_t(2), wanted));
     }
 
    public:
-    const T& operator()(size_t i, size_t j) const {
-        if (i >= R || j >= C) {
-            throw std::invalid_argument("out of range");
+    typedef T value_type;
+
+    template <class E>
+    explicit QR(const MatrixExpr<E>& expr, QrMode mode = QrMode::AUTO) {
+        Matrix<T> a(expr.self());
+        m = a.rowLength();
+        n = a.columnLength();
+        SJTU_COUNT_OP(stats::QR, a.Size(),
+                      2.0 * min(m, n) * min(m, n) *
+                          (max(m, n) - min(m, n) / 3.0));
+        const bool tsqr =
+            n > 0 &&
+            (mode == QrMode::TSQR ||
+             (mode == QrMode::AUTO && m >= detail::TSQR_MIN_RATIO * n &&
+              m * n * sizeof(T) > 2 * detail::TSQR_BLOCK_BYTES));
+        for (size_t p; tsqr && (p = parts(a.rowLength())) > 1;) {
+            Level level;
+            level.offsets.resize(p + 1);
+            for (size_t i = 0; i <= p; i++)
+                level.offsets[i] = a.rowLength() * i / p;
+            level.blocks.resize(p);
+            Matrix<T> stacked(p * n, n);
+            ThreadPool::global().parallelFor(p, [&](size_t i) {
+                const size_t lo = level.offsets[i], hi = level.offsets[i + 1];
+                level.blocks[i] = detail::Householder<T>(
+                    Matrix<T>(a.block(lo, 0, hi - lo, n)));
+                stacked.block(i * n, 0, n, n) = level.blocks[i].R();
+            });
+            levels.push_back(std::move(level));
+            a = std::move(stacked);
         }
-        return Data[i * C + j];
+        top = detail::Householder<T>(std::move(a));
     }
 
-    T& operator()(size_t i, size_t j) {
-        if (i >= R || j >= C) {
-            throw std::invalid_argument("out of range");
-        }
-        return Data[i * C + j];
+    size_t rowLength() const { return m; }
+
+    size_t columnLength() const { return n; }
+
+    // the number of row blocks in the first round of TSQR, 1 without it
+    size_t rowBlocks() const {
+        return levels.empty() ? 1 : levels.front().blocks.size();
     }
 
-    Matrix<T> row(size_t i) const {
-        if (i >= R) {
-            throw std::invalid_argument("out of range");
-        }
-        Matrix ret(1, C);
-        for (size_t c = 0; c < C; c++) {
-            ret(0, c) = Data[i * C + c];
+    // min(m, n) x n, upper triangular
+    Matrix<T> R() const { return top.R(); }
+
+    // m x min(m, n), with orthonormal columns
+    Matrix<T> Q() const {
+        const size_t r = min(m, n);
+        Matrix<T> id(r, r, T(0));
+        for (size_t i = 0; i < r; i++)
+            id.data()[i * r + i] = T(1);
+        Matrix<T> z = top.expand(id);
+        for (size_t l = levels.size(); l-- > 0;) {
+            const Level& level = levels[l];
+            Matrix<T> q(level.offsets.back(), n);
+            const auto& blocks = level.blocks;
+            ThreadPool::global().parallelFor(blocks.size(), [&](size_t i) {
+                const size_t lo = level.offsets[i], hi = level.offsets[i + 1];
+                q.block(lo, 0, hi - lo, n) =
+                    blocks[i].expand(z.block(i * n, 0, n, n));
+            });
+            z = std::move(q);
         }
-        return ret;
+        return z;
     }
 
-    Matrix<T> column(size_t i) const {
-        if (i >= C) {
-            throw std::invalid_argument("out of range");
+    /**
+     * The X minimizing the 2-norm of each column of AX - B: R X = Q^T B,
+     * without ever forming A^T A. A must have full column rank.
+     */
+    template <class E>
+    Matrix<T> solve(const MatrixExpr<E>& rhs) const {
+        Matrix<T> c(rhs.self());
+        if (c.rowLength() != m) {
+            throw std::invalid_argument("invalid right-hand side");
         }
-        Matrix ret(R, 1);
-        for (size_t r = 0; r < R; r++) {
-            ret(r, 0) = Data[r * C + i];
+        if (m < n) {
+            throw std::invalid_argument("least squares with fewer rows "
+                                        "than columns");
         }
-        return ret;
+        const Matrix<T>& r = top.packed();
+        for (size_t i = 0; i < n; i++)
+            if (r.data()[i * n + i] == T(0)) {
+                throw std::invalid_argument("least squares with a "
+                                            "rank-deficient matrix");
+            }
+        // Q^T b level by level, keeping the leading n rows of each block
+        const size_t k = c.columnLength();
+        for (const Level& level : levels) {
+            const auto& blocks = level.blocks;
+            Matrix<T> stacked(blocks.size() * n, k);
+            ThreadPool::global().parallelFor(blocks.size(), [&](size_t i) {
+                const size_t lo = level.offsets[i], hi = level.offsets[i + 1];
+                stacked.block(i * n, 0, n, k) =
+                    blocks[i].reduce(Matrix<T>(c.block(lo, 0, hi - lo, k)));
+            });
+            c = std::move(stacked);
+        }
+        Matrix<T> x = top.reduce(std::move(c));
+        detail::solveUpper(r.data(), n, x);
+        return x;
     }
+};
 
-   public:
-    template <class U>
-    bool operator==(const Matrix<U>& o) const {
-        return R == o.R && C == o.C && Data == o.Data;  // XXX
-    }
+// the least-squares solution of ax = b by QR; integers are solved in double
+template <class E, class F>
+Matrix<detail::FieldType<typename E::value_type>> lstsq(
+    const MatrixExpr<E>& a,
+    const MatrixExpr<F>& b) {
+    return QR<detail::FieldType<typename E::value_type>>(a).solve(b);
+}
 
-    template <class U>
-    bool operator!=(const Matrix<U>& o) const {
-        return !(R == o.R && C == o.C && Data == o.Data);  // XXX
-    }
+namespace detail {
+/**
+ * The first 64 bytes of a file written by save(). The elements follow
+ * row-major at offset, in the byte order of the machine that saved them,
+ * so that load() can map them as they are.
+ */
+struct MatrixFileHeader {
+    char magic[8];               // MATRIX_FILE_MAGIC
+    std::uint32_t version;       // MATRIX_FILE_VERSION when written
+    std::uint32_t byteOrder;     // BYTE_ORDER_MARK as stored by the writer
+    std::uint32_t dtype;         // see fileType()
+    std::uint32_t elementSize;
+    std::uint64_t rows, cols;
+    std::uint64_t offset;        // of the elements, a multiple of alignment
+    std::uint64_t alignment;
+    std::uint64_t checksum;      // of the element bytes, see fileChecksum()
+};
+static_assert(sizeof(MatrixFileHeader) == 64, "matrix file header layout");
+
+const char MATRIX_FILE_MAGIC[8] = {'S', 'J', 'T', 'U', 'M', 'A', 'T', '\0'};
+const std::uint32_t MATRIX_FILE_VERSION = 1;
+const std::uint32_t BYTE_ORDER_MARK = 0x01020304;
+// elements start on a cache line, as in AlignedAllocator
+const size_t MATRIX_FILE_ALIGN = 64;
+
+// the kind of T in the high byte and its size in the low one; 0 if a
+// matrix of T cannot be saved
+template <class T>
+constexpr std::uint32_t fileType() {
+    return std::is_same<T, bool>::value         ? 0
+           : std::is_floating_point<T>::value ? 0x300 + sizeof(T)
+           : !std::is_integral<T>::value      ? 0
+           : std::is_signed<T>::value         ? 0x100 + sizeof(T)
+                                              : 0x200 + sizeof(T);
+}
+
+const std::uint64_t HASH_P1 = 0x9E3779B185EBCA87ULL;
+const std::uint64_t HASH_P2 = 0xC2B2AE3D27D4EB4FULL;
 
-    Matrix operator-() const {
-        Matrix ret(*this);
-        for (size_t i = 0; i < R * C; i++) {
-            ret[i] = -ret[i];
+inline std::uint64_t hashRound(std::uint64_t acc, std::uint64_t w) {
+    acc += w * HASH_P2;
+    acc = (acc << 31) | (acc >> 33);
+    return acc * HASH_P1;
+}
+
+// a 64-bit hash of n bytes after xxHash64: four independent lanes of
+// 8-byte words, so that it runs at memory speed
+inline std::uint64_t hashBytes(const unsigned char* p,
+                               size_t n,
+                               std::uint64_t seed) {
+    std::uint64_t lane[4] = {seed + HASH_P1 + HASH_P2, seed + HASH_P2, seed,
+                             seed - HASH_P1};
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+        for (int j = 0; j < 4; j++) {
+            std::uint64_t w;
+            std::memcpy(&w, p + i + 8 * j, 8);
+            lane[j] = hashRound(lane[j], w);
         }
-        return ret;
+    std::uint64_t h = n;
+    for (int j = 0; j < 4; j++)
+        h = hashRound(h, lane[j]);
+    for (; i < n; i++)
+        h = hashRound(h, p[i]);
+    h ^= h >> 33;
+    h *= HASH_P2;
+    h ^= h >> 29;
+    h *= HASH_P1;
+    return h ^ (h >> 32);
+}
+
+// the checksum hashes chunks of this many bytes in parallel, then the
+// chunk hashes in order, so it does not depend on the thread count
+const size_t CHECKSUM_CHUNK = size_t(1) << 20;
+
+inline std::uint64_t fileChecksum(const void* data, size_t n) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    std::vector<std::uint64_t> hashes((n + CHECKSUM_CHUNK - 1) /
+                                      CHECKSUM_CHUNK);
+    parallelChunks(hashes.size(), 1, [&](size_t lo, size_t hi) {
+        for (size_t i = lo; i < hi; i++)
+            hashes[i] = hashBytes(p + i * CHECKSUM_CHUNK,
+                                  min(CHECKSUM_CHUNK, n - i * CHECKSUM_CHUNK),
+                                  i);
+    });
+    return hashBytes(reinterpret_cast<const unsigned char*>(hashes.data()),
+                     hashes.size() * sizeof(std::uint64_t), n);
+}
+
+// throws unless h describes a matrix of T that fits in length bytes
+template <class T>
+void checkFileHeader(const MatrixFileHeader& h,
+                     size_t length,
+                     const std::string& path) {
+    if (std::memcmp(h.magic, MATRIX_FILE_MAGIC, sizeof(h.magic)) != 0)
+        throw std::runtime_error(path + ": not a matrix file");
+    if (h.byteOrder != BYTE_ORDER_MARK)
+        throw std::runtime_error(path + ": saved with another byte order");
+    if (h.version > MATRIX_FILE_VERSION)
+        throw std::runtime_error(path + ": newer matrix file version");
+    if (h.dtype != fileType<T>() || h.elementSize != sizeof(T))
+        throw std::runtime_error(path + ": matrix of another element type");
+    if (h.alignment == 0 || h.offset % h.alignment != 0 ||
+        h.offset % alignof(T) != 0 || h.offset < sizeof(h) ||
+        h.offset > length ||
+        (h.rows != 0 && h.cols > (length - h.offset) / sizeof(T) / h.rows))
+        throw std::runtime_error(path + ": truncated matrix file");
+}
+
+template <class T>
+MatrixFileHeader fileHeader(size_t rows, size_t cols, std::uint64_t checksum) {
+    MatrixFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, MATRIX_FILE_MAGIC, sizeof(h.magic));
+    h.version = MATRIX_FILE_VERSION;
+    h.byteOrder = BYTE_ORDER_MARK;
+    h.dtype = fileType<T>();
+    h.elementSize = sizeof(T);
+    h.rows = rows;
+    h.cols = cols;
+    h.offset = sizeof(h);
+    h.alignment = MATRIX_FILE_ALIGN;
+    h.checksum = checksum;
+    return h;
+}
+
+typedef std::unique_ptr<std::FILE, int (*)(std::FILE*)> FilePtr;
+
+// fseek() and ftell() with 64-bit offsets, which long is not everywhere
+inline bool seekFile(std::FILE* f, std::uint64_t offset, int whence) {
+#ifdef _WIN32
+    return _fseeki64(f, (long long)offset, whence) == 0;
+#else
+    return fseeko(f, off_t(offset), whence) == 0;
+#endif
+}
+
+inline std::int64_t tellFile(std::FILE* f) {
+#ifdef _WIN32
+    return _ftelli64(f);
+#else
+    return std::int64_t(ftello(f));
+#endif
+}
+
+inline FilePtr openFile(const std::string& path, const char* mode) {
+    FilePtr f(std::fopen(path.c_str(), mode), &std::fclose);
+    if (!f)
+        throw std::runtime_error("cannot open " + path);
+    return f;
+}
+
+// opens a matrix file of T and reads its header into h
+template <class T>
+FilePtr openMatrixFile(const std::string& path, MatrixFileHeader& h) {
+    FilePtr f = openFile(path, "rb");
+    seekFile(f.get(), 0, SEEK_END);
+    const std::int64_t length = tellFile(f.get());
+    std::rewind(f.get());
+    if (length < std::int64_t(sizeof(h)) ||
+        std::fread(&h, sizeof(h), 1, f.get()) != 1)
+        throw std::runtime_error(path + ": not a matrix file");
+    checkFileHeader<T>(h, size_t(length), path);
+    return f;
+}
+}  // namespace detail
+
+/**
+ * A read-only matrix loaded from a file written by save(). On Linux the
+ * file is mapped instead of read: loading costs no copy, pages come in on
+ * first touch, and processes loading the same file share them. Elsewhere
+ * it is read into memory. Use view() to compute with it.
+ */
+template <class T>
+class MappedMatrix {
+    static_assert(detail::fileType<T>() != 0,
+                  "matrix files hold arithmetic elements only");
+
+    const T* p = NULL;
+    size_t R = 0, C = 0;
+    void* base = NULL;  // the mapping, if any
+    size_t length = 0;
+    Vector<T> copy;  // the elements, if not mapped
+
+    void unmap() {
+#ifdef __linux__
+        if (base != NULL)
+            munmap(base, length);
+#endif
+        base = NULL;
     }
 
     template <class U>
-    Matrix& operator+=(const Matrix<U>& o) {
-        if (R != o.R || C != o.C) {
-            throw std::invalid_argument("addition between invalid matrices");
-        }
-        for (size_t i = 0; i < Data.size(); i++)
-            Data[i] = T(Data[i] + o.Data[i]);
-        return *this;
+    friend MappedMatrix<U> load(const std::string& path, bool verify);
+
+   public:
+    typedef T value_type;
+
+    MappedMatrix() {}
+
+    MappedMatrix(const MappedMatrix&) = delete;
+    MappedMatrix& operator=(const MappedMatrix&) = delete;
+
+    MappedMatrix(MappedMatrix&& o) noexcept
+        : p(o.p), R(o.R), C(o.C), base(o.base), length(o.length),
+          copy(std::move(o.copy)) {
+        o.p = NULL, o.R = o.C = 0, o.base = NULL;
     }
 
-    template <class U>
-    Matrix& operator-=(const Matrix<U>& o) {
-        if (R != o.R || C != o.C) {
-            throw std::invalid_argument("subtraction between invalid matrices");
+    MappedMatrix& operator=(MappedMatrix&& o) noexcept {
+        if (this != &o) {
+            unmap();
+            p = o.p, R = o.R, C = o.C, base = o.base, length = o.length;
+            copy = std::move(o.copy);
+            o.p = NULL, o.R = o.C = 0, o.base = NULL;
         }
-        for (size_t i = 0; i < Data.size(); i++)
-            Data[i] = T(Data[i] - o.Data[i]);
         return *this;
     }
 
-    template <class U>
-    Matrix& operator*=(const U& x) {
-        for (size_t i = 0; i < Data.size(); i++)
-            Data[i] = T(Data[i] * x);
-        return *this;
-    }
+    ~MappedMatrix() { unmap(); }
 
-    Matrix tran() const {
-        Matrix tmp(C, R);
-        for (size_t i = 0; i < R; i++)
-            for (size_t j = 0; j < C; j++) {
-                tmp(j, i) = (*this)(i, j);
-            }
-        return tmp;
+    size_t rowLength() const { return R; }
+    size_t columnLength() const { return C; }
+    size_t Size() const { return R * C; }
+    std::pair<size_t, size_t> size() const { return std::make_pair(R, C); }
+    const T* data() const { return p; }
+    bool mapped() const { return base != NULL; }
+
+    const T& operator()(size_t i, size_t j) const {
+        detail::checkIndex(i < R && j < C);
+        return p[i * C + j];
     }
 
-   public:  // iterator
-    class iterator {
-       public:
-        using iterator_category = std::random_access_iterator_tag;
-        using value_type = T;
-        using pointer = T*;
-        using reference = T&;
-        using size_type = size_t;
-        using difference_type = std::ptrdiff_t;
+    const T& at(size_t i, size_t j) const {
+        detail::checkIndexAlways(i < R && j < C);
+        return p[i * C + j];
+    }
 
-        iterator() = default;
+    MatrixView<const T> view() const { return MatrixView<const T>(p, R, C, C); }
+};
 
-        iterator(const iterator&) = default;
+/**
+ * Writes m to path in the format of detail::MatrixFileHeader; throws
+ * std::runtime_error if the file cannot be written.
+ */
+template <class T, class A>
+void save(const std::string& path, const Matrix<T, A>& m) {
+    static_assert(detail::fileType<T>() != 0,
+                  "matrix files hold arithmetic elements only");
+    SJTU_COUNT_OP(stats::SAVE, m.Size(), 0);
+    const detail::MatrixFileHeader h = detail::fileHeader<T>(
+        m.rowLength(), m.columnLength(),
+        detail::fileChecksum(m.data(), m.Size() * sizeof(T)));
+    detail::FilePtr f = detail::openFile(path, "wb");
+    if (std::fwrite(&h, sizeof(h), 1, f.get()) != 1 ||
+        (m.Size() != 0 &&
+         std::fwrite(m.data(), sizeof(T), m.Size(), f.get()) != m.Size()) ||
+        std::fclose(f.release()) != 0)
+        throw std::runtime_error("cannot write " + path);
+}
 
-        iterator& operator=(const iterator&) = default;
+template <class E>
+void save(const std::string& path, const MatrixExpr<E>& e) {
+    save(path, Matrix<typename E::value_type>(e.self()));
+}
 
-       private:
-        size_t sx, sy, ex, ey, x, y;
-        Matrix* mat;
+/**
+ * The matrix saved in path, which must hold elements of type T. The
+ * header is always checked; the checksum only with verify, as it reads
+ * the whole file. Throws std::runtime_error on a bad or missing file.
+ */
+template <class T>
+MappedMatrix<T> load(const std::string& path, bool verify = false) {
+    SJTU_COUNT_OP(stats::LOAD, 0, 0);
+    MappedMatrix<T> ret;
+    detail::MatrixFileHeader h;
+#ifdef __linux__
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(h))
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping keeps the file open
+    if (base == MAP_FAILED)
+        throw std::runtime_error(path + ": not a matrix file");
+    ret.base = base;
+    ret.length = st.st_size;
+    std::memcpy(&h, base, sizeof(h));
+    detail::checkFileHeader<T>(h, ret.length, path);
+    ret.p = reinterpret_cast<const T*>(static_cast<const char*>(base) +
+                                       h.offset);
+#else
+    detail::FilePtr f = detail::openMatrixFile<T>(path, h);
+    ret.copy.resize(h.rows * h.cols);
+    if (!detail::seekFile(f.get(), h.offset, SEEK_SET) ||
+        (ret.copy.size() != 0 &&
+         std::fread(ret.copy.data(), sizeof(T), ret.copy.size(), f.get()) !=
+             ret.copy.size()))
+        throw std::runtime_error(path + ": truncated matrix file");
+    ret.p = ret.copy.data();
+#endif
+    ret.R = h.rows;
+    ret.C = h.cols;
+    SJTU_COUNT(ops[stats::LOAD].elements, ret.Size());
+    if (verify &&
+        detail::fileChecksum(ret.p, ret.Size() * sizeof(T)) != h.checksum)
+        throw std::runtime_error(path + ": checksum mismatch");
+    return ret;
+}
 
-        difference_type id() const {
-            return difference_type((x - sx) * (ey - sy + 1) + y);
-        }
+namespace detail {
+// copies blocks of a matrix file into memory, see multiplyOutOfCore()
+template <class T>
+class TileReader {
+#ifdef __linux__
+    MappedMatrix<T> m;
 
-       public:
-        iterator(size_t _sx,
-                 size_t _sy,
-                 size_t _ex,
-                 size_t _ey,
-                 size_t _x,
-                 size_t _y,
-                 Matrix* a) {
-            sx = _sx;
-            sy = _sy;
-            ex = _ex;
-            ey = _ey;
-            x = _x;
-            y = _y;
-            mat = a;
-        }
-
-        difference_type operator-(const iterator& o) const {
-            if (sx != o.sx || sy != o.sy || ex != o.ex || ey != o.ey ||
-                mat != o.mat)
-                return difference_type(-1);
-            return difference_type(id() - o.id());
-        }
-
-        iterator& operator+=(difference_type offset) {
-            x += offset / (ey - sy + 1);
-            y += offset % (ey - sy + 1);
-            if (y > ey) {
-                y -= (ey - sy + 1);
-                x += 1;
-            }
-            if (x > ex || (x == ex && y > ey + 1)) {
-                throw std::invalid_argument("out of range");
-            }
-            return *this;
-        }
+   public:
+    explicit TileReader(const std::string& path) : m(load<T>(path)) {}
 
-        iterator operator+(difference_type offset) const {
-            iterator ret(*this);
-            ret += offset;
-            return ret;
-        }
+    size_t rowLength() const { return m.rowLength(); }
+    size_t columnLength() const { return m.columnLength(); }
 
-        iterator& operator-=(difference_type offset) {
-            if (id() < offset) {
-                throw std::invalid_argument("out of range");
-            } else {
-                x -= offset / (ey - sy + 1);
-                y -= offset % (ey - sy + 1);
-                if (y < sy) {
-                    y += (ey - sy + 1);
-                    x -= 1;
-                }
-            }
-            return *this;
-        }
+    // the rows x cols block at (i, j) into dst, row-major
+    void read(size_t i, size_t j, size_t rows, size_t cols, T* dst) const {
+        for (size_t r = 0; r < rows; r++)
+            std::memcpy(dst + r * cols,
+                        m.data() + (i + r) * m.columnLength() + j,
+                        cols * sizeof(T));
+    }
+#else
+    MatrixFileHeader h;
+    FilePtr f;
+    std::string path;
 
-        iterator operator-(difference_type offset) const {
-            iterator ret(*this);
-            ret -= offset;
-            return ret;
-        }
+   public:
+    explicit TileReader(const std::string& _path)
+        : f(openMatrixFile<T>(_path, h)), path(_path) {}
 
-        iterator& operator++() {
-            y++;
-            if (x < ex && y > ey)
-                y = sy, x++;
-            if (x > ex || (x == ex && y > ey + 1)) {
-                throw std::invalid_argument("out of range");
-            }
-            return *this;
-        }
+    size_t rowLength() const { return h.rows; }
+    size_t columnLength() const { return h.cols; }
 
-        iterator operator++(int) {
-            iterator ret(*this);
-            y++;
-            if (x < ex && y > ey)
-                y = sy, x++;
-            if (x > ex || (x == ex && y > ey + 1)) {
-                throw std::invalid_argument("out of range");
-            }
-            return ret;
-        }
+    void read(size_t i, size_t j, size_t rows, size_t cols, T* dst) const {
+        for (size_t r = 0; r < rows; r++)
+            if (!seekFile(f.get(),
+                          h.offset + ((i + r) * h.cols + j) * sizeof(T),
+                          SEEK_SET) ||
+                std::fread(dst + r * cols, sizeof(T), cols, f.get()) != cols)
+                throw std::runtime_error(path + ": truncated matrix file");
+    }
+#endif
+};
 
-        iterator& operator--() {
-            if (id() == 0) {
-                throw std::invalid_argument("out of range");
-            }
-            if (y == sy) {
-                x--, y = ey;
-            } else {
-                y--;
-            }
-            return *this;
-        }
+// writes the blocks of a matrix file as they come, the checksum last
+template <class T>
+class TileWriter {
+    FilePtr f;
+    std::string path;
+    size_t R, C;
 
-        iterator operator--(int) {
-            iterator ret(*this);
-            if (id() == 0) {
-                throw std::invalid_argument("out of range");
-            }
-            if (y == sy) {
-                x--, y = ey;
-            } else {
-                y--;
-            }
-            return ret;
-        }
+    void fail() const { throw std::runtime_error("cannot write " + path); }
 
-        reference operator*() const { return (*mat)(x, y); }
+    void seek(size_t offset) const {
+        if (!seekFile(f.get(), offset, SEEK_SET))
+            fail();
+    }
 
-        pointer operator->() const { return &((*mat)(x, y)); }
+   public:
+    TileWriter(const std::string& _path, size_t rows, size_t cols)
+        : f(openFile(_path, "w+b")), path(_path), R(rows), C(cols) {
+        const MatrixFileHeader h = fileHeader<T>(R, C, 0);
+        if (std::fwrite(&h, sizeof(h), 1, f.get()) != 1)
+            fail();
+    }
 
-        bool operator==(const iterator& o) const {
-            return x == o.x && y == o.y && sx == o.sx && sy == o.sy &&
-                   ex == o.ex && ey == o.ey && mat == o.mat;
+    void write(size_t i, size_t j, size_t rows, size_t cols, const T* src) {
+        for (size_t r = 0; r < rows; r++) {
+            seek(sizeof(MatrixFileHeader) + ((i + r) * C + j) * sizeof(T));
+            if (std::fwrite(src + r * cols, sizeof(T), cols, f.get()) != cols)
+                fail();
         }
+    }
 
-        bool operator!=(const iterator& o) const {
-            return !(x == o.x && y == o.y && sx == o.sx && sy == o.sy &&
-                     ex == o.ex && ey == o.ey && mat == o.mat);
+    // reads the elements back in chunks to fill in the checksum, as
+    // fileChecksum() would compute it
+    void close() {
+        const size_t n = R * C * sizeof(T);
+        std::vector<unsigned char> chunk(min(n, CHECKSUM_CHUNK));
+        std::vector<std::uint64_t> hashes;
+        if (std::fflush(f.get()) != 0)
+            fail();
+        seek(sizeof(MatrixFileHeader));
+        for (size_t at = 0; at < n; at += CHECKSUM_CHUNK) {
+            const size_t len = min(CHECKSUM_CHUNK, n - at);
+            if (std::fread(chunk.data(), 1, len, f.get()) != len)
+                fail();
+            hashes.push_back(hashBytes(chunk.data(), len, hashes.size()));
         }
+        const std::uint64_t checksum = hashBytes(
+            reinterpret_cast<const unsigned char*>(hashes.data()),
+            hashes.size() * sizeof(std::uint64_t), n);
+        seek(offsetof(MatrixFileHeader, checksum));
+        if (std::fwrite(&checksum, sizeof(checksum), 1, f.get()) != 1 ||
+            std::fclose(f.release()) != 0)
+            fail();
+    }
+};
+
+/**
+ * Tile sizes of an out-of-core product within a budget of elements: two
+ * A tiles (tm x tk), two B tiles (tk x tn) and two C tiles (tm x tn), so
+ * that the next tiles load while the current ones multiply. Square tiles
+ * with tk no larger than tm and tn keep the reloads of A and B low.
+ */
+struct TilePlan {
+    size_t tm, tn, tk;
+    bool byRows;  // C tiles row by row, else column by column
+};
+
+inline TilePlan planTiles(size_t M, size_t N, size_t K, size_t elements) {
+    if (elements < 6) {
+        throw std::invalid_argument("memory budget too small");
+    }
+    const double e = double(elements / 2);  // for one set of tiles
+    TilePlan p;
+    p.tk = max(size_t(1), min(K, size_t(std::sqrt(e / 3))));
+    // then tm = tn = s with s^2 + 2 s tk <= e
+    const double tk = double(p.tk);
+    const size_t s = max(size_t(1), size_t(std::sqrt(tk * tk + e) - tk));
+    const size_t budget = elements / 2;
+    // the longest side y of C tiles x by y that fits next to x by tk of A
+    auto spare = [&](size_t x) {
+        return x * p.tk < budget ? (budget - x * p.tk) / (p.tk + x) : 0;
     };
+    p.tm = min(M, s);
+    p.tn = min(N, spare(p.tm));
+    if (p.tn == 0) {
+        p.tn = 1;
+        p.tm = min(p.tm, spare(1));
+    }
+    if (p.tm == 0) {
+        throw std::invalid_argument("memory budget too small");
+    }
+    if (p.tm < M)
+        p.tm = max(p.tm, min(M, spare(p.tn)));
+    // each tile row of C reloads all of B once, each tile column all of A;
+    // a panel of A kept over a whole row of C is loaded only once
+    const double rowTiles = double((M + p.tm - 1) / p.tm);
+    const double colTiles = double((N + p.tn - 1) / p.tn);
+    const double a = double(M) * K, b = double(K) * N;
+    const double rows = (p.tk >= K ? a : a * colTiles) + b * rowTiles;
+    const double cols = (p.tk >= K ? b : b * rowTiles) + a * colTiles;
+    p.byRows = rows <= cols;
+    return p;
+}
 
-    iterator begin() { return iterator(0, 0, R - 1, C - 1, 0, 0, this); }
+// a cached tile of A or B, named by its corner
+template <class T>
+struct TileSlot {
+    Vector<T> data;
+    size_t i = size_t(-1), j = size_t(-1);
+};
+}  // namespace detail
 
-    iterator end() {
-        return iterator(0, 0, R - 1, C - 1, R - 1, C - (R == 0 || C == 0),
-                        this);
+/**
+ * Writes the product of the matrix files a and b, as written by save(),
+ * to the file c, for operands too large for memory. The product goes
+ * tile by tile in buffers of at most memoryBudget bytes in all (besides
+ * the packing buffers of the GEMM itself). A background thread loads the
+ * next tiles and writes back the last tile of C while the current ones
+ * multiply. C tiles are visited in a snake order that reuses the tile of
+ * A or B at hand, and along rows or columns, whichever reloads less.
+ */
+template <class T>
+void multiplyOutOfCore(const std::string& a,
+                       const std::string& b,
+                       const std::string& c,
+                       size_t memoryBudget) {
+    const detail::TileReader<T> ra(a), rb(b);
+    const size_t M = ra.rowLength(), K = ra.columnLength();
+    const size_t N = rb.columnLength();
+    if (rb.rowLength() != K) {
+        throw std::invalid_argument("multiplication between invalid matrices");
     }
+    const detail::TilePlan plan =
+        detail::planTiles(M, N, K, memoryBudget / sizeof(T));
+    SJTU_COUNT_OP(stats::OUT_OF_CORE, M * N, 2.0 * M * N * K);
+    const size_t tm = plan.tm, tn = plan.tn, tk = plan.tk;
+    const size_t rowTiles = (M + tm - 1) / tm, colTiles = (N + tn - 1) / tn;
+    const size_t depth = max(size_t(1), (K + tk - 1) / tk);
 
-    std::pair<iterator, iterator> subMatrix(std::pair<size_t, size_t> l,
-                                            std::pair<size_t, size_t> r) {
-        if (l.first > r.first || l.second > r.second) {
-            throw std::invalid_argument("invalid submatrix");
+    // the corners (i, j, k) of the steps, in order
+    struct Step {
+        size_t i, j, k;
+        bool first, last;  // of the steps of its tile of C
+    };
+    std::vector<Step> steps;
+    const size_t outer = plan.byRows ? rowTiles : colTiles;
+    const size_t inner = plan.byRows ? colTiles : rowTiles;
+    for (size_t o = 0; o < outer; o++)
+        for (size_t x = 0; x < inner; x++) {
+            const size_t y = o % 2 == 0 ? x : inner - 1 - x;
+            const size_t ti = plan.byRows ? o : y, tj = plan.byRows ? y : o;
+            const bool up = steps.size() / depth % 2 == 0;
+            for (size_t d = 0; d < depth; d++) {
+                const size_t tkk = up ? d : depth - 1 - d;
+                steps.push_back(
+                    {ti * tm, tj * tn, tkk * tk, d == 0, d + 1 == depth});
+            }
         }
-        return std::make_pair(iterator(l.first, l.second, r.first, r.second,
-                                       l.first, l.second, this),
-                              iterator(l.first, l.second, r.first, r.second,
-                                       r.first, r.second + 1, this));
+
+    detail::TileSlot<T> as[2], bs[2];
+    Vector<T> cs[2];
+    for (int s = 0; s < 2; s++) {
+        as[s].data.resize(tm * tk);
+        bs[s].data.resize(tk * tn);
+        cs[s].resize(tm * tn);
     }
-};
+    detail::TileWriter<T> wc(c, M, N);
 
-}  // namespace sjtu
+    // which slot holds the tile at (i, j), loading it into the one other
+    // than cur if neither does; returns whether it has to be loaded
+    const auto assign = [](detail::TileSlot<T>* slots, int& cur, size_t i,
+                           size_t j) {
+        for (int s : {cur, 1 - cur})
+            if (slots[s].i == i && slots[s].j == j) {
+                cur = s;
+                return false;
+            }
+        cur = 1 - cur;
+        slots[cur].i = i, slots[cur].j = j;
+        return true;
+    };
+    int ca = 0, cb = 0, cc = 0;
+    struct Pending {
+        bool any = false;
+        size_t i, j;
+        int slot;
+    } finished;
+    // assigns the slots of step s and returns the work to bring them in,
+    // together with writing back the tile of C finished before
+    const auto prepare = [&](size_t s) {
+        const Step& st = steps[s];
+        const size_t rows = min(tm, M - st.i), cols = min(tn, N - st.j);
+        const size_t depthK = min(tk, K - st.k);
+        const bool la = assign(as, ca, st.i, st.k);
+        const bool lb = assign(bs, cb, st.k, st.j);
+        T* pa = as[ca].data.data();
+        T* pb = bs[cb].data.data();
+        const Pending w = finished;
+        finished.any = false;
+        return [&, st, rows, cols, depthK, la, lb, pa, pb, w] {
+            if (la)
+                ra.read(st.i, st.k, rows, depthK, pa);
+            if (lb)
+                rb.read(st.k, st.j, depthK, cols, pb);
+            if (w.any)
+                wc.write(w.i, w.j, min(tm, M - w.i), min(tn, N - w.j),
+                         cs[w.slot].data());
+        };
+    };
 
-//
-namespace sjtu {
-template <class T, class U>
-auto operator*(const Matrix<T>& mat, const U& x)
-    -> Matrix<decltype(T() * U())> {
-    Matrix<decltype(T() * U())> ret(mat);
-    for (size_t i = 0; i < mat.rowLength(); i++) {
-        for (size_t j = 0; j < mat.columnLength(); j++) {
-            ret(i, j) *= x;
+    std::future<void> io;
+    if (!steps.empty())
+        io = std::async(std::launch::async, prepare(0));
+    for (size_t s = 0; s < steps.size(); s++) {
+        io.get();
+        const Step& st = steps[s];
+        const size_t rows = min(tm, M - st.i), cols = min(tn, N - st.j);
+        const size_t depthK = min(tk, K - st.k);
+        const MatrixView<T> va(as[ca].data.data(), rows, depthK, depthK);
+        const MatrixView<T> vb(bs[cb].data.data(), depthK, cols, cols);
+        const MatrixView<T> vc(cs[cc].data(), rows, cols, cols);
+        // step s + 1 never loads into the slots in use now
+        if (s + 1 < steps.size()) {
+            io = std::async(std::launch::async, prepare(s + 1));
+        } else if (finished.any) {
+            wc.write(finished.i, finished.j, min(tm, M - finished.i),
+                     min(tn, N - finished.j), cs[finished.slot].data());
+        }
+        if (st.first)
+            std::fill(cs[cc].data(), cs[cc].data() + rows * cols, T());
+        detail::gemmInto(vc, va, vb);
+        if (st.last) {
+            finished = {true, st.i, st.j, cc};
+            cc = 1 - cc;
         }
     }
-    return ret;
+    if (finished.any)
+        wc.write(finished.i, finished.j, min(tm, M - finished.i),
+                 min(tn, N - finished.j), cs[finished.slot].data());
+    wc.close();
 }
 
-template <class T, class U>
-auto operator*(const U& x, const Matrix<T>& mat)
-    -> Matrix<decltype(T() * U())> {
-    Matrix<decltype(T() * U())> ret(mat);
-    for (size_t i = 0; i < mat.rowLength(); i++) {
-        for (size_t j = 0; j < mat.columnLength(); j++) {
-            ret(i, j) *= x;
+namespace detail {
+// text is parsed in chunks of at least this many bytes, cut at newlines
+const size_t TEXT_CHUNK = size_t(1) << 20;
+// the most characters to_chars() needs for one element
+const size_t MAX_TEXT_FIELD = 48;
+
+template <class T>
+struct IsTextElement {
+    static constexpr bool value =
+        std::is_arithmetic<T>::value && !std::is_same<T, bool>::value;
+};
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+inline const char* skipBlanks(const char* p, const char* end) {
+    while (p != end && isBlank(*p))
+        p++;
+    return p;
+}
+
+// the rows parsed from one chunk of text
+template <class T>
+struct TextChunk {
+    std::vector<T> values;
+    size_t lines = 0;  // newlines seen, empty lines included
+    size_t rows = 0, cols = 0;
+    size_t firstLine = 0;  // of the first row, counted from the chunk
+    size_t errorLine = 0;  // likewise, if error is set
+    const char* error = NULL;
+};
+
+// parses the whole lines in [p, end) into out, one row per nonempty line
+template <class T>
+void parseChunk(const char* p, const char* end, char sep, TextChunk<T>& out) {
+    out.values.reserve(size_t(end - p) / 4);
+    for (; p != end; out.lines++) {
+        const char* eol =
+            static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+        const char* next = eol == NULL ? end : eol + 1;
+        if (eol == NULL)
+            eol = end;
+        if (eol != p && eol[-1] == '\r')
+            eol--;
+        const char* q = skipBlanks(p, eol);
+        p = next;
+        if (q == eol)
+            continue;
+        size_t cols = 0;
+        for (;;) {
+            // a sign of its own: "+-3" is not a number
+            if (q != eol && *q == '+' && q + 1 != eol && q[1] != '-')
+                q++;
+            T v;
+            const std::from_chars_result r = std::from_chars(q, eol, v);
+            if (r.ec != std::errc()) {
+                out.error = r.ec == std::errc::result_out_of_range
+                                ? "number out of range"
+                                : "expected a number";
+                out.errorLine = out.lines;
+                return;
+            }
+            out.values.push_back(v);
+            cols++;
+            q = skipBlanks(r.ptr, eol);
+            if (q == eol)
+                break;
+            if (sep == ' ' ? q == r.ptr : *q != sep) {
+                out.error = "expected a separator";
+                out.errorLine = out.lines;
+                return;
+            }
+            if (sep != ' ')
+                q = skipBlanks(q + 1, eol);
+        }
+        if (out.rows++ == 0) {
+            out.cols = cols;
+            out.firstLine = out.lines;
+        } else if (cols != out.cols) {
+            out.error = "rows of different lengths";
+            out.errorLine = out.lines;
+            return;
         }
     }
-    return ret;
 }
 
-template <class U, class V>
-auto operator*(const Matrix<U>& a, const Matrix<V>& b)
-    -> Matrix<decltype(U() * V())> {
-    if (a.columnLength() != b.rowLength()) {
-        throw std::invalid_argument("multiplication between invalid matrices");
+/**
+ * Parses [first, last) in parallel chunks that each start after a
+ * newline, then copies the rows into place; the shape comes out of the
+ * same pass. Errors name the line, after name and a colon if given.
+ */
+template <class T>
+Matrix<T> parseText(const char* first,
+                    const char* last,
+                    char sep,
+                    const std::string& name) {
+    SJTU_COUNT_OP(stats::READ_TEXT, 0, 0);
+    const size_t n = size_t(last - first);
+    const size_t chunks =
+        max(size_t(1), min(n / TEXT_CHUNK, ThreadPool::global().size() * 8));
+    std::vector<const char*> cuts(chunks + 1, last);
+    cuts[0] = first;
+    for (size_t i = 1; i < chunks; i++) {
+        const char* at = max(cuts[i - 1], first + n / chunks * i);
+        const char* eol =
+            static_cast<const char*>(std::memchr(at, '\n', size_t(last - at)));
+        cuts[i] = eol == NULL ? last : eol + 1;
     }
-    Matrix<decltype(U() * V())> ret(a.rowLength(), b.columnLength(), 0);
-    for (size_t i = 0; i < a.rowLength(); i++)
-        for (size_t k = 0; k < a.columnLength(); k++)
-            for (size_t j = 0; j < b.columnLength(); j++) {
-                ret(i, j) += a(i, k) * b(k, j);
-            }
+    std::vector<TextChunk<T>> parts(chunks);
+    ThreadPool::global().parallelFor(chunks, [&](size_t i) {
+        parseChunk(cuts[i], cuts[i + 1], sep, parts[i]);
+    });
+
+    size_t rows = 0, cols = 0, lines = 0;
+    std::vector<size_t> offsets(chunks);
+    for (size_t i = 0; i < chunks; i++) {
+        const TextChunk<T>& part = parts[i];
+        const char* error = part.error;
+        if (error == NULL && part.rows != 0 && rows != 0 && part.cols != cols)
+            error = "rows of different lengths";
+        if (error != NULL) {
+            const size_t line =
+                lines +
+                (part.error != NULL ? part.errorLine : part.firstLine) + 1;
+            throw std::runtime_error(
+                (name.empty() ? "line " : name + ":") + std::to_string(line) +
+                ": " + error);
+        }
+        if (part.rows != 0 && rows == 0)
+            cols = part.cols;
+        offsets[i] = rows * cols;
+        rows += part.rows;
+        lines += part.lines;
+    }
+    SJTU_COUNT(ops[stats::READ_TEXT].elements, rows * cols);
+    Matrix<T> ret(rows, cols);
+    ThreadPool::global().parallelFor(chunks, [&](size_t i) {
+        if (!parts[i].values.empty())
+            std::memcpy(ret.data() + offsets[i], parts[i].values.data(),
+                        parts[i].values.size() * sizeof(T));
+    });
     return ret;
 }
+}  // namespace detail
 
-template <class U, class V>
-auto operator+(const Matrix<U>& a, const Matrix<V>& b)
-    -> Matrix<decltype(U() + V())> {
-    if (a.rowLength() != b.rowLength() ||
-        a.columnLength() != b.columnLength()) {
-        throw std::invalid_argument("addition between invalid matrices");
+/**
+ * The matrix in text, one row per line. With sep ' ' the elements are
+ * split by runs of spaces and tabs, otherwise by sep (',' for CSV) with
+ * blanks around it ignored. Empty lines and \r before a newline are
+ * skipped; throws std::runtime_error naming the line of a malformed
+ * element or a row of a different length.
+ */
+template <class T>
+Matrix<T> parseText(const std::string& text, char sep = ' ') {
+    static_assert(detail::IsTextElement<T>::value,
+                  "text holds arithmetic elements only");
+    return detail::parseText<T>(text.data(), text.data() + text.size(), sep,
+                                std::string());
+}
+
+// parseText() of the file at path, which on Linux is mapped, not read
+template <class T>
+Matrix<T> readText(const std::string& path, char sep = ' ') {
+    static_assert(detail::IsTextElement<T>::value,
+                  "text holds arithmetic elements only");
+#ifdef __linux__
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    void* base = MAP_FAILED;
+    const bool ok = fstat(fd, &st) == 0;
+    if (ok && st.st_size > 0)
+        base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (ok && st.st_size == 0)
+        return Matrix<T>();
+    if (base == MAP_FAILED)
+        throw std::runtime_error("cannot read " + path);
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+    struct Unmap {
+        void* p;
+        size_t n;
+        ~Unmap() { munmap(p, n); }
+    } guard = {base, size_t(st.st_size)};
+    const char* first = static_cast<const char*>(base);
+    return detail::parseText<T>(first, first + guard.n, sep, path);
+#else
+    detail::FilePtr f = detail::openFile(path, "rb");
+    std::string text;
+    char buffer[1 << 16];
+    for (size_t got; (got = std::fread(buffer, 1, sizeof(buffer), f.get()));)
+        text.append(buffer, got);
+    if (std::ferror(f.get()))
+        throw std::runtime_error("cannot read " + path);
+    return detail::parseText<T>(text.data(), text.data() + text.size(), sep,
+                                path);
+#endif
+}
+
+/**
+ * Writes m to path as text that readText() takes back exactly: one row
+ * per line, elements split by sep, floating point in the shortest form
+ * that round-trips. Row blocks are formatted in parallel and written in
+ * order, a bounded window at a time.
+ */
+template <class E>
+void writeText(const std::string& path,
+               const MatrixExpr<E>& e,
+               char sep = ' ') {
+    typedef typename E::value_type T;
+    static_assert(detail::IsTextElement<T>::value,
+                  "text holds arithmetic elements only");
+    const auto& m = detail::materialize(e.self());
+    const size_t R = m.rowLength(), C = m.columnLength();
+    SJTU_COUNT_OP(stats::WRITE_TEXT, R * C, 0);
+    detail::FilePtr f = detail::openFile(path, "wb");
+    const size_t grain =
+        max(size_t(1), detail::ELEMENTWISE_GRAIN / max(C, size_t(1)));
+    const size_t window = grain * ThreadPool::global().size() * 2;
+    std::vector<std::string> out;
+    for (size_t r0 = 0; C != 0 && r0 < R; r0 += window) {
+        const size_t r1 = min(R, r0 + window);
+        out.assign((r1 - r0 + grain - 1) / grain, std::string());
+        ThreadPool::global().parallelFor(out.size(), [&](size_t c) {
+            const size_t lo = r0 + c * grain, hi = min(r1, lo + grain);
+            std::string& s = out[c];
+            s.resize((hi - lo) * C * (detail::MAX_TEXT_FIELD + 1));
+            char* p = &s[0];
+            char* const end = p + s.size();
+            for (size_t i = lo; i < hi; i++)
+                for (size_t j = 0; j < C; j++) {
+                    p = std::to_chars(p, end, T(m(i, j))).ptr;
+                    *p++ = j + 1 == C ? '\n' : sep;
+                }
+            s.resize(size_t(p - s.data()));
+        });
+        for (const std::string& s : out)
+            if (std::fwrite(s.data(), 1, s.size(), f.get()) != s.size())
+                throw std::runtime_error("cannot write " + path);
     }
-    Matrix<decltype(U() + V())> ret(a.rowLength(), b.columnLength(), 0);
-    for (size_t i = 0; i < a.rowLength(); i++)
-        for (size_t j = 0; j < a.columnLength(); j++) {
-            ret(i, j) = a(i, j) + b(i, j);
-        }
-    return ret;
+    if (std::fclose(f.release()) != 0)
+        throw std::runtime_error("cannot write " + path);
 }
 
-template <class U, class V>
-auto operator-(const Matrix<U>& a, const Matrix<V>& b)
-    -> Matrix<decltype(U() - V())> {
-    if (a.rowLength() != b.rowLength() ||
-        a.columnLength() != b.columnLength()) {
-        throw std::invalid_argument("subtraction between invalid matrices");
+/**
+ * count() matrices of one shape, interleaved for SIMD across the batch:
+ * packs of LANES matrices store each element (i, j) of all of them in
+ * LANES consecutive slots, one cache line, so a kernel works on a whole
+ * pack with one vector per element. Element (i, j) of matrix b is at
+ * data()[((b / LANES * rows + i) * cols + j) * LANES + b % LANES]. The
+ * last pack is padded with zero matrices.
+ */
+template <class T>
+class MatrixBatch {
+   public:
+    static constexpr size_t LANES = detail::batchLanes<T>();
+
+    typedef T value_type;
+
+    MatrixBatch() : N(0), R(0), C(0) {}
+
+    MatrixBatch(size_t count, size_t rows, size_t cols)
+        : N(count), R(rows), C(cols) {
+        Data.resize(packs() * R * C * LANES, T());
+    }
+
+    size_t count() const { return N; }
+    size_t rowLength() const { return R; }
+    size_t columnLength() const { return C; }
+    size_t packs() const { return (N + LANES - 1) / LANES; }
+
+    T* data() { return Data.data(); }
+    const T* data() const { return Data.data(); }
+
+    T& operator()(size_t b, size_t i, size_t j) {
+        detail::checkIndex(b < N && i < R && j < C);
+        return Data[index(b, i, j)];
+    }
+
+    const T& operator()(size_t b, size_t i, size_t j) const {
+        detail::checkIndex(b < N && i < R && j < C);
+        return Data[index(b, i, j)];
+    }
+
+    // a copy of matrix b
+    Matrix<T> get(size_t b) const {
+        detail::checkIndexAlways(b < N);
+        Matrix<T> ret(R, C);
+        for (size_t i = 0; i < R; i++)
+            for (size_t j = 0; j < C; j++)
+                ret(i, j) = Data[index(b, i, j)];
+        return ret;
     }
-    Matrix<decltype(U() - V())> ret(a.rowLength(), b.columnLength(), 0);
-    for (size_t i = 0; i < a.rowLength(); i++)
-        for (size_t j = 0; j < a.columnLength(); j++) {
-            ret(i, j) = a(i, j) - b(i, j);
+
+    template <class E>
+    void set(size_t b, const MatrixExpr<E>& e) {
+        detail::checkIndexAlways(b < N);
+        const auto& m = detail::materialize(e.self());
+        if (m.rowLength() != R || m.columnLength() != C) {
+            throw std::invalid_argument("assignment between invalid matrices");
         }
-    return ret;
+        for (size_t i = 0; i < R; i++)
+            for (size_t j = 0; j < C; j++)
+                Data[index(b, i, j)] = T(m(i, j));
+    }
+
+   private:
+    Vector<T> Data;
+    size_t N, R, C;
+
+    size_t index(size_t b, size_t i, size_t j) const {
+        return ((b / LANES * R + i) * C + j) * LANES + b % LANES;
+    }
+};
+
+namespace detail {
+// multiply-adds per task of a batched product
+const size_t BATCH_GRAIN = size_t(1) << 18;
+}  // namespace detail
+
+/**
+ * c[b] = a[b] * b[b] for every matrix of the batches, into the storage c
+ * already has, with no allocation. Packs are spread over the thread pool
+ * and each runs one vector kernel over all its lanes at once. c must not
+ * be a or b: the kernels overwrite c while still reading the operands.
+ */
+template <class T>
+void multiplyBatch(MatrixBatch<T>& c,
+                   const MatrixBatch<T>& a,
+                   const MatrixBatch<T>& b) {
+    const size_t M = a.rowLength(), K = a.columnLength();
+    const size_t N = b.columnLength();
+    if (a.count() != b.count() || c.count() != a.count() ||
+        b.rowLength() != K || c.rowLength() != M || c.columnLength() != N) {
+        throw std::invalid_argument("multiplication between invalid matrices");
+    }
+    if (c.data() && (c.data() == a.data() || c.data() == b.data())) {
+        throw std::invalid_argument("multiplication into one of its operands");
+    }
+    SJTU_COUNT_OP(stats::MULTIPLY, c.count() * M * N,
+                  2.0 * c.count() * M * N * K);
+    constexpr size_t L = MatrixBatch<T>::LANES;
+    const T* pa = a.data();
+    const T* pb = b.data();
+    T* pc = c.data();
+    const size_t work = max(size_t(1), M * N * K * L);
+    detail::parallelChunks(
+        c.packs(), max(size_t(1), detail::BATCH_GRAIN / work),
+        [&](size_t lo, size_t hi) {
+            for (size_t q = lo; q < hi; q++)
+                simd::batchGemm(M, N, K, pa + q * M * K * L,
+                                pb + q * K * N * L, pc + q * M * N * L);
+        });
 }
 
 }  // namespace sjtu
 
+#undef SJTU_UNROLL
+#undef SJTU_COUNT_OP
+#undef SJTU_COUNT
+
 #endif  // SJTU_MATrowLength()IX_HPP